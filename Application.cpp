@@ -5,6 +5,7 @@
  **********************************/
 
 #include "Application.h"
+#include "Batch.h"
 
 void handler(int sig) {
 	void *array[10];
@@ -26,13 +27,23 @@ void handler(int sig) {
  **********************************/
 int main(int argc, char *argv[]) {
 	//signal(SIGSEGV, handler);
-	if ( argc != ARGS_COUNT ) {
+	if ( argc >= ARGS_COUNT && !strcmp(argv[1], BATCH_FLAG) ) {
+		Batch batch;
+		if ( !batch.parseArgs(argc - 2, argv + 2) ) {
+			cout<<"Usage: Application -batch [-j threads] [-o dir] a.conf [b.conf ...] [KEY=v1,v2 ...]"<<endl;
+			return FAILURE;
+		}
+		batch.run();
+		batch.writeSummary();
+		return SUCCESS;
+	}
+	if ( argc != ARGS_COUNT && argc != ARGS_COUNT_LOCAL ) {
 		cout<<"Configuration (i.e., *.conf) file File Required"<<endl;
 		return FAILURE;
 	}
 
 	// Create a new application object
-	Application *app = new Application(argv[1]);
+	Application *app = new Application(argv[1], (argc == ARGS_COUNT_LOCAL) ? atoi(argv[2]) : 0);
 	// Call the run function
 	app->run();
 	// When done delete the application object
@@ -43,30 +54,175 @@ int main(int argc, char *argv[]) {
 
 /**
  * Constructor of the Application class
+ * localNode != 0 runs only that node in this process (other processes run the rest)
+ * settings are "KEY: value" lines applied on top of the conf file
  */
-Application::Application(char *infile) {
+Application::Application(char *infile, int localNode, const vector<string> &settings) {
 	int i;
+	// this run's timings go to its own profiler, whichever thread runs it
+	PROF_USE(&profiler);
 	par = new Params();
-	srand (time(NULL));
-	par->setparams(infile);
-	log = new Log(par);
-	en = new EmulNet(par);
-	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
+	par->setparams(infile, settings);
+	if ( par->OUTDIR[0] ) {
+		mkdir(par->OUTDIR, 0755);
+	}
+	par->LOCAL_NODE = localNode;
+	if ( localNode ) {
+		sprintf(par->LOG_PREFIX, "node%d.", localNode);
+	}
+	// all processes of a multi-process run must draw the same failures: give them the same SEED
+	failRandState = par->SEED ? par->SEED : time(NULL);
+	srand(failRandState + localNode);
+	metrics = new Metrics();
+	log = new Log(par, metrics);
+	worker = -1;
+	workers = 0;
+	killDeadWorkers = false;
+	liveWorkers = 0;
+	firstTick = 0;
+	activeDirty = false;
+	trace = NULL;
+	eventsLog = NULL;
+	memset(&summary, 0, sizeof(summary));
+	if ( par->TRANSPORT == TRANSPORT_UDP ) {
+		en = new UdpNet(par);
+	}
+	else if ( par->TRANSPORT == TRANSPORT_SHM ) {
+		en = new ShmNet(par);
+	}
+	else {
+		en = new EmulNet(par);
+	}
+
+	// the nodes' generators pick gossip and ping targets: a replay has to draw what the recording did
+	uint64_t nodeSeed = failRandState + localNode;
+	if ( par->TRACE_RECORD[0] || par->TRACE_REPLAY[0] ) {
+		bool record = par->TRACE_REPLAY[0] == 0;
+		const char *file = record ? par->TRACE_RECORD : par->TRACE_REPLAY;
+		trace = new Trace();
+		if ( !en->setTrace(trace) ) {
+			printf("Cannot %s trace %s: needs the emul transport, tracing off\n", record ? "record" : "replay", file);
+		}
+		else if ( !trace->open(file, record, nodeSeed) ) {
+			printf("Cannot %s trace %s: %s, tracing off\n", record ? "record" : "replay", file,
+					errno ? strerror(errno) : "not a trace");
+		}
+		if ( !trace->recording() && !trace->replaying() ) {
+			delete trace;
+			trace = NULL;
+			en->setTrace(NULL);
+		}
+	}
 
 	/*
 	 * Init all nodes
 	 */
+	// zoned, a view holds the node's whole zone and ZONE_LINKS members of other zones; flat, the
+	// ring overlay needs the whole membership, since a ring over a 5-entry view that gossip keeps
+	// reshuffling is neither global nor stable
+	nodes = new NodeStore(par->zoned() ? par->zoneCapacity() + par->ZONE_LINKS
+			: par->wideViews() ? MAX_NODES : GOSSIP_PAYLOAD_SIZE, nodeSeed);
+	nodes->reserve(par->EN_GPSZ);
 	for( i = 0; i < par->EN_GPSZ; i++ ) {
-		Member *memberNode = new Member;
-		memberNode->inited = false;
-		Address *addressOfMemberNode = new Address();
-		Address joinaddr;
-		joinaddr = getjoinaddr();
-		addressOfMemberNode = (Address *) en->ENinit(addressOfMemberNode, par->PORTNUM);
-		mp1[i] = new MP1Node(memberNode, par, en, log, addressOfMemberNode);
-		log->LOG(&(mp1[i]->getMemberNode()->addr), "APP");
-		delete addressOfMemberNode;
+		addNode();
+	}
+	buildDefaultTimeline();
+
+	if ( par->CHURN_RATE > 0 ) {
+		// the shm segment has no room for new ids
+		ChurnGenerator churn(par, rand_r(&failRandState));
+		churn.generate(par->TIMELINE, TOTAL_RUNNING_TIME, par->TRANSPORT == TRANSPORT_SHM ? par->EN_GPSZ : MAX_NODES);
+		metrics->openWindows(par->logfile(CHURN_LOG).c_str(), par->CHURN_WINDOW, par->CHURN_REPORT);
+	}
+
+	if ( (!par->CHECKPOINT_AT.empty() || par->RESTORE_FROM[0]) && par->TRANSPORT != TRANSPORT_EMUL ) {
+		printf("Checkpoints need the emul transport, CHECKPOINT_AT and RESTORE_FROM ignored\n");
+		par->CHECKPOINT_AT.clear();
+		par->RESTORE_FROM[0] = 0;
+	}
+	if ( par->RESTORE_FROM[0] ) {
+		restoreCheckpoint();
+	}
+}
+
+/**
+ * FUNCTION NAME: addNode
+ *
+ * DESCRIPTION: Create the next node; it runs once a join event starts it
+ */
+void Application::addNode() {
+	Member memberNode(nodes, nodes->add());
+	Address *addressOfMemberNode = new Address();
+	Address joinaddr;
+	joinaddr = getjoinaddr();
+	addressOfMemberNode = (Address *) en->ENinit(addressOfMemberNode, par->PORTNUM);
+	mp1.push_back(MP1Node(memberNode, par, en, log, addressOfMemberNode));
+	if ( par->MEMBER_EVENTS ) {
+		mp1.back().eventQueue();
+	}
+	startTick.push_back(-1);
+	log->LOG(&memberNode.addr(), "APP");
+	delete addressOfMemberNode;
+}
+
+/**
+ * FUNCTION NAME: buildDefaultTimeline
+ *
+ * DESCRIPTION: Fill in what the conf file's timeline leaves out with the canned scenario:
+ * 				node i joins at STEP_RATE*i unless it has a join event, and unless the timeline scripts its own failures,
+ * 				message drops from 50 to 300 (DROP_MSG) and one (SINGLE_FAILURE) or half of the
+ * 				nodes crash at 100.
+ */
+void Application::buildDefaultTimeline() {
+	Timeline &tl = par->TIMELINE;
+	TimelineEvent ev;
+	int i, removed;
+
+	ev.node = ev.src = ev.dst = 0;
+	ev.value = 0;
+	vector<bool> scripted(par->EN_GPSZ + 1, false);
+	for ( size_t k = 0; k < tl.size(); k++ ) {
+		if ( tl.at(k).action == TL_JOIN && tl.at(k).node <= par->EN_GPSZ ) {
+			scripted[tl.at(k).node] = true;
+		}
 	}
+	ev.action = TL_JOIN;
+	for ( i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( !scripted[i + 1] ) {
+			ev.time = (int)(par->STEP_RATE*i);
+			ev.node = i + 1;
+			tl.add(ev);
+		}
+	}
+
+	if ( !tl.has(TL_CRASH) && !tl.has(TL_LEAVE) && !tl.has(TL_RESTART) && !tl.has(TL_DROP) ) {
+		if ( par->DROP_MSG ) {
+			ev.action = TL_DROP;
+			ev.time = 50;
+			ev.value = par->MSG_DROP_PROB;
+			tl.add(ev);
+			ev.time = 300;
+			ev.value = 0;
+			tl.add(ev);
+		}
+
+		// Victims come from failRandState so every process of a multi-process run picks the same ones
+		ev.action = TL_CRASH;
+		ev.time = 100;
+		if( par->SINGLE_FAILURE ) {
+			removed = (rand_r(&failRandState) % par->EN_GPSZ);
+			ev.node = removed + 1;
+			tl.add(ev);
+		}
+		else {
+			removed = rand_r(&failRandState) % par->EN_GPSZ/2;
+			for ( i = removed; i < removed + par->EN_GPSZ/2; i++ ) {
+				ev.node = i + 1;
+				tl.add(ev);
+			}
+		}
+	}
+	tl.sort();
 }
 
 /**
@@ -75,11 +231,15 @@ Application::Application(char *infile) {
 Application::~Application() {
 	delete log;
 	delete en;
-	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
-		delete mp1[i];
+	delete trace;
+	mp1.clear();
+	delete nodes;
+	if ( eventsLog != NULL ) {
+		fclose(eventsLog);
 	}
-	free(mp1);
+	delete metrics;
 	delete par;
+	PROF_USE(NULL);
 }
 
 /**
@@ -93,76 +253,396 @@ int Application::run()
 	int timeWhenAllNodesHaveJoined = 0;
 	// boolean indicating if all nodes have joined
 	bool allNodesJoined = false;
-	srand(time(NULL));
 
-	// As time runs along
-	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
-		// Run the membership protocol
-		mp1Run();
-		// Fail some nodes
-		fail();
+	if ( par->TRANSPORT == TRANSPORT_SHM ) {
+		// The nodes run in worker processes, this one only keeps time and fails nodes
+		runWorkers();
+	}
+	else {
+		// As time runs along
+		for( par->globaltime = firstTick; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
+			waitForTick();
+			// Run the membership protocol
+			mp1Run();
+			en->ENflush();
+			// Fail some nodes
+			fail();
+			drainEvents();
+			sampleViews();
+			metrics->endTick(par->getcurrtime(), en->getSentMessages(), en->getSentBytes());
+			if ( find(par->CHECKPOINT_AT.begin(), par->CHECKPOINT_AT.end(), par->getcurrtime()) != par->CHECKPOINT_AT.end() ) {
+				saveCheckpoint();
+			}
+			PROF_TICK();
+		}
 	}
 
 	// Clean up
 	en->ENcleanup();
+	metrics->report(par->logfile(METRICS_LOG).c_str(), en->getSentBytes(), &summary);
 
-	for(i=0;i<=par->EN_GPSZ-1;i++) {
-		 mp1[i]->finishUpThisNode();
+	for(i=0;i<=(int)mp1.size()-1;i++) {
+		 mp1[i].finishUpThisNode();
 	}
 
 	return SUCCESS;
 }
 
+/**
+ * FUNCTION NAME: runWorkers
+ *
+ * DESCRIPTION: Shared-memory mode. Fork the worker processes (node i runs in worker i % workers),
+ * 				then act as coordinator: open each tick, wait for every live worker to finish it
+ * 				and inject the failures in between.
+ */
+void Application::runWorkers() {
+	ShmNet *shm = (ShmNet *)en;
+	int w;
+
+	workers = (par->SHM_WORKERS > 0 && par->SHM_WORKERS < par->EN_GPSZ) ? par->SHM_WORKERS : par->EN_GPSZ;
+	// nothing buffered may be inherited, or it would be written once per process
+	fflush(NULL);
+	for ( w = 0; w < workers; w++ ) {
+		pid_t pid = fork();
+		if ( pid < 0 ) {
+			perror("fork");
+			exit(1);
+		}
+		if ( pid == 0 ) {
+			worker = w;
+			workerLoop();
+			exit(0);
+		}
+		workerPids.push_back(pid);
+	}
+	liveWorkers = workers;
+	killDeadWorkers = !par->TIMELINE.has(TL_RESTART);
+
+	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
+		waitForTick();
+		// the workers start the nodes themselves; here restarts clear the failed flags
+		applyEvents(true);
+		shm->openTick(par->globaltime);
+		shm->waitForArrivals(liveWorkers);
+		// start times are known here; adds and removes are seen by the workers and passed on in the segment
+		for ( size_t i = 0; i < mp1.size(); i++ ) {
+			if ( par->getcurrtime() == startTick[i] ) {
+				metrics->recordStart(mp1[i].getMemberNode().addr().getNodeId(), par->getcurrtime());
+			}
+		}
+		shm->drainObservations(metrics);
+		// Fail some nodes
+		fail();
+		metrics->endTick(par->getcurrtime(), en->getSentMessages(), en->getSentBytes());
+		PROF_TICK();
+	}
+
+	for ( w = 0; w < workers; w++ ) {
+		if ( workerPids[w] > 0 ) {
+			waitpid(workerPids[w], NULL, 0);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: workerLoop
+ *
+ * DESCRIPTION: Body of a worker process: run this worker's nodes one tick at a time
+ */
+void Application::workerLoop() {
+	ShmNet *shm = (ShmNet *)en;
+
+	sprintf(par->LOG_PREFIX, "w%d.", worker);
+	// the coordinator's log files were inherited: write w<worker>.dbg.log, and the metrics go to the coordinator
+	delete metrics;
+	metrics = new ShmMetrics(shm);
+	log->reopen(metrics);
+	shm->seedWorker(worker);
+	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
+		shm->waitForTick(par->globaltime);
+		for ( int i = worker; i < par->EN_GPSZ; i += workers ) {
+			if ( shm->isFailed(i + 1) && !nodes->isFailed(i) ) {
+				nodes->setFlag(i, NODE_FAILED, true);
+				activeDirty = true;
+			}
+		}
+		mp1Run();
+		drainEvents();
+		// crashes and drop rate changes reach the worker through the segment
+		while ( par->TIMELINE.next(par->getcurrtime(), false) != NULL );
+		PROF_TICK();
+		shm->arrive();
+	}
+	PROF_DUMP(par->logfile(PROFILE_LOG).c_str());
+	fflush(NULL);
+}
+
+/**
+ * FUNCTION NAME: failNode
+ *
+ * DESCRIPTION: Fail the ith node. In shared-memory mode the worker learns it through the segment,
+ * 				and a worker whose nodes have all failed is killed outright unless the timeline
+ * 				restarts nodes.
+ */
+void Application::failNode(int i) {
+	nodes->setFlag(i, NODE_FAILED, true);
+	activeDirty = true;
+	if ( par->TRANSPORT != TRANSPORT_SHM ) {
+		return;
+	}
+
+	ShmNet *shm = (ShmNet *)en;
+	int w = i % workers;
+	shm->markFailed(i + 1);
+	if ( !killDeadWorkers ) {
+		return;
+	}
+	for ( int j = w; j < par->EN_GPSZ; j += workers ) {
+		if ( !shm->isFailed(j + 1) ) {
+			return;
+		}
+	}
+	if ( workerPids[w] > 0 ) {
+		kill(workerPids[w], SIGKILL);
+		waitpid(workerPids[w], NULL, 0);
+		workerPids[w] = 0;
+		liveWorkers--;
+	}
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load the whole simulation: the clock, drop rate and timeline of Params,
+ * 				when each node started, every Member, the metrics so far and the network with
+ * 				its messages in flight and RNG states. Loading adds the nodes the timeline
+ * 				created after the start.
+ *
+ * RETURNS:
+ * false if the checkpoint does not fit this run
+ */
+bool Application::checkpoint(Checkpoint &ck) {
+	int gpsz = par->EN_GPSZ;
+	int count = mp1.size();
+
+	ck.pod(gpsz);
+	ck.pod(count);
+	if ( ck.loading() ) {
+		if ( !ck.good() || gpsz != par->EN_GPSZ || count < (int)mp1.size() || count > MAX_NODES ) {
+			return false;
+		}
+		while ( (int)mp1.size() < count ) {
+			addNode();
+		}
+	}
+	par->checkpoint(ck);
+	ck.pod(failRandState);
+	ck.podVector(startTick);
+	if ( startTick.size() != mp1.size() ) {
+		return false;
+	}
+	if ( !nodes->checkpoint(ck) ) {
+		return false;
+	}
+	metrics->checkpoint(ck);
+	return en->checkpoint(ck) && ck.good();
+}
+
+/**
+ * FUNCTION NAME: saveCheckpoint
+ *
+ * DESCRIPTION: Write the state at the end of the current tick to CHECKPOINT_FILE
+ */
+void Application::saveCheckpoint() {
+	char name[64];
+	Checkpoint ck;
+
+	sprintf(name, CHECKPOINT_FILE, par->getcurrtime());
+	string file = par->logfile(name);
+	if ( !ck.open(file.c_str(), true) || !checkpoint(ck) ) {
+		printf("Cannot write checkpoint %s\n", file.c_str());
+		return;
+	}
+	ck.close();
+	if ( !ck.good() ) {
+		printf("Cannot write checkpoint %s\n", file.c_str());
+	}
+}
+
+/**
+ * FUNCTION NAME: restoreCheckpoint
+ *
+ * DESCRIPTION: Load RESTORE_FROM; run() then carries on with the tick after the saved one.
+ * 				A run that cannot be restored stops here rather than quietly starting from tick 0.
+ */
+void Application::restoreCheckpoint() {
+	Checkpoint ck;
+
+	if ( !ck.open(par->RESTORE_FROM, false) || !checkpoint(ck) ) {
+		printf("Cannot restore checkpoint %s (missing, corrupt or from another EN_GPSZ)\n", par->RESTORE_FROM);
+		exit(1);
+	}
+	firstTick = par->globaltime + 1;
+	rebuildActive();
+}
+
+/**
+ * FUNCTION NAME: drainEvents
+ *
+ * DESCRIPTION: MEMBER_EVENTS: empty this process's event queues into EVENTS_LOG,
+ * 				one "tick observer event member heartbeat" line per view change
+ */
+void Application::drainEvents() {
+	MemberEvent ev;
+
+	if ( !par->MEMBER_EVENTS ) {
+		return;
+	}
+	if ( eventsLog == NULL && (eventsLog = fopen(par->logfile(EVENTS_LOG).c_str(), "w")) == NULL ) {
+		return;
+	}
+	for ( size_t i = 0; i < mp1.size(); i++ ) {
+		MemberEventQueue *queue = isLocal(i) ? mp1[i].eventQueue() : NULL;
+		while ( queue != NULL && queue->pop(ev) ) {
+			fprintf(eventsLog, "%d %s %s %s %ld\n", ev.time, ev.observer.toString().c_str(), memberEventName(ev.type),
+					ev.member.toString().c_str(), ev.heartbeat);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: waitForTick
+ *
+ * DESCRIPTION: With TICK_MS set, sleep until the current tick is due on the wall clock,
+ * 				so processes that started together stay in step
+ */
+void Application::waitForTick() {
+	struct timespec due;
+
+	if ( par->TICK_MS <= 0 ) {
+		return;
+	}
+	if ( par->globaltime == firstTick ) {
+		clock_gettime(CLOCK_MONOTONIC, &tickStart);
+	}
+	long long ns = (long long)(par->globaltime - firstTick) * par->TICK_MS * 1000000LL + tickStart.tv_nsec;
+	due.tv_sec = tickStart.tv_sec + ns / 1000000000LL;
+	due.tv_nsec = ns % 1000000000LL;
+	clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, NULL);
+}
+
+/**
+ * FUNCTION NAME: isLocal
+ *
+ * DESCRIPTION: Is the ith node run by this process
+ */
+bool Application::isLocal(int i) {
+	if ( worker >= 0 ) {
+		return i % workers == worker;
+	}
+	return par->LOCAL_NODE == 0 || par->LOCAL_NODE == i + 1;
+}
+
 /**
  * FUNCTION NAME: mp1Run
  *
- * DESCRIPTION:	This function performs all the membership protocol functionalities
+ * DESCRIPTION:	This function performs all the membership protocol functionalities.
+ * 				Only the running nodes (active) and the ones starting this tick are visited,
+ * 				in the same order as a sweep over all the nodes would.
  */
 void Application::mp1Run() {
 	int i;
+	size_t a, s;
 
-	// For all the nodes in the system
-	for( i = 0; i <= par->EN_GPSZ-1; i++) {
+	// Joins and restarts of this tick
+	applyEvents(true);
+	compactActive();
 
+	// For all the running nodes
+	for( a = 0; a < active.size(); a++ ) {
 		/*
 		 * Receive messages from the network and queue them in the membership protocol queue
 		 */
-		if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
-			// Receive messages from the network and queue them
-			mp1[i]->recvLoop();
-		}
-
+		mp1[active[a]].recvLoop();
 	}
 
-	// For all the nodes in the system
-	for( i = par->EN_GPSZ - 1; i >= 0; i-- ) {
-
+	// For all the running and starting nodes, from the highest index down
+	sort(starting.begin(), starting.end());
+	a = active.size();
+	s = starting.size();
+	while ( a > 0 || s > 0 ) {
 		/*
 		 * Introduce nodes into the distributed system
 		 */
-		if( par->getcurrtime() == (int)(par->STEP_RATE*i) ) {
-			// introduce the ith node into the system at time STEPRATE*i
-			mp1[i]->nodeStart(JOINADDR, par->PORTNUM);
-			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
-			nodeCount += i;
+		if( s > 0 && (a == 0 || starting[s - 1] > active[a - 1]) ) {
+			i = starting[--s];
+			// introduce the ith node into the system at the time of its join (or restart) event
+			mp1[i].nodeStart(JOINADDR, par->PORTNUM);
+			metrics->recordStart(mp1[i].getMemberNode().addr().getNodeId(), par->getcurrtime());
+			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i].getMemberNode().addr().getAddress() << endl;
 		}
 
 		/*
 		 * Handle all the messages in your queue and send heartbeats
 		 */
-		else if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
+		else {
+			i = active[--a];
 			// handle messages and send heartbeats
-			mp1[i]->nodeLoop();
+			mp1[i].nodeLoop();
 			#ifdef DEBUGLOG
 			if( (i == 0) && (par->globaltime % 500 == 0) ) {
-				log->LOG(&mp1[i]->getMemberNode()->addr, "@@time=%d", par->getcurrtime());
+				log->LOG(&mp1[i].getMemberNode().addr(), "@@time=%d", par->getcurrtime());
 			}
 			#endif
 		}
+	}
 
+	// the started nodes run from the next tick on
+	if ( !starting.empty() ) {
+		size_t running = active.size();
+		active.insert(active.end(), starting.begin(), starting.end());
+		inplace_merge(active.begin(), active.begin() + running, active.end());
+		starting.clear();
 	}
 }
 
+/**
+ * FUNCTION NAME: compactActive
+ *
+ * DESCRIPTION: Drop the nodes that failed or were restarted since the last pass from active
+ */
+void Application::compactActive() {
+	size_t kept = 0;
+
+	if ( !activeDirty ) {
+		return;
+	}
+	for ( size_t a = 0; a < active.size(); a++ ) {
+		int i = active[a];
+		if ( !nodes->isFailed(i) && startTick[i] < par->getcurrtime() ) {
+			active[kept++] = i;
+		}
+	}
+	active.resize(kept);
+	activeDirty = false;
+}
+
+/**
+ * FUNCTION NAME: rebuildActive
+ *
+ * DESCRIPTION: Recompute active from scratch: the local nodes started before now that have not failed
+ */
+void Application::rebuildActive() {
+	active.clear();
+	starting.clear();
+	for ( int i = 0; i < (int)mp1.size(); i++ ) {
+		if ( isLocal(i) && startTick[i] >= 0 && startTick[i] <= par->getcurrtime() && !nodes->isFailed(i) ) {
+			active.push_back(i);
+		}
+	}
+	activeDirty = false;
+}
+
 /**
  * FUNCTION NAME: fail
  *
@@ -171,34 +651,147 @@ void Application::mp1Run() {
  * Note: this is used only by MP1
  */
 void Application::fail() {
-	int i, removed;
+	PROF_SCOPE(PROF_FAIL, -1);
 
-	// fail half the members at time t=400
-	if( par->DROP_MSG && par->getcurrtime() == 50 ) {
-		par->dropmsg = 1;
-	}
+	// Crashes, drop rate changes and network faults scripted for this tick
+	applyEvents(false);
+}
+
+/**
+ * FUNCTION NAME: applyEvents
+ *
+ * DESCRIPTION: Apply the timeline events due now: joins and restarts before the nodes run,
+ * 				everything else after
+ */
+void Application::applyEvents(bool beforeRun) {
+	TimelineEvent *ev;
+	const TraceRecord *rec;
 
-	if( par->SINGLE_FAILURE && par->getcurrtime() == 100 ) {
-		removed = (rand() % par->EN_GPSZ);
-		#ifdef DEBUGLOG
-		log->LOG(&mp1[removed]->getMemberNode()->addr, "Node failed at time=%d", par->getcurrtime());
-		#endif
-		mp1[removed]->getMemberNode()->bFailed = true;
+	if ( trace != NULL && trace->replaying() ) {
+		// the recorded events replace the timeline, whose random failures may have differed
+		TimelineEvent replayed;
+		while ( (rec = trace->peek()) != NULL && rec->kind == TR_EVENT && rec->tick <= par->getcurrtime() &&
+				(!beforeRun || Timeline::runsBeforeTick(rec->verdict)) ) {
+			trace->readEvent(replayed);
+			applyEvent(replayed);
+		}
+		return;
 	}
-	else if( par->getcurrtime() == 100 ) {
-		removed = rand() % par->EN_GPSZ/2;
-		for ( i = removed; i < removed + par->EN_GPSZ/2; i++ ) {
-			#ifdef DEBUGLOG
-			log->LOG(&mp1[i]->getMemberNode()->addr, "Node failed at time = %d", par->getcurrtime());
-			#endif
-			mp1[i]->getMemberNode()->bFailed = true;
+	while ( (ev = par->TIMELINE.next(par->getcurrtime(), beforeRun)) != NULL ) {
+		if ( trace != NULL ) {
+			trace->writeEvent(par->getcurrtime(), *ev);
 		}
+		applyEvent(*ev);
 	}
+}
 
-	if( par->DROP_MSG && par->getcurrtime() == 300) {
-		par->dropmsg=0;
+/**
+ * FUNCTION NAME: applyEvent
+ *
+ * DESCRIPTION: Apply one timeline event. Each process only crashes or starts the nodes it runs.
+ */
+void Application::applyEvent(TimelineEvent &ev) {
+	int i = ev.node - 1;
+	int id;
+
+	switch ( ev.action ) {
+		case TL_JOIN:
+		case TL_RESTART:
+			if ( i >= MAX_NODES || (i >= (int)mp1.size() && par->TRANSPORT == TRANSPORT_SHM) ) {
+				if ( worker < 0 ) {
+					printf("Node %d is beyond MAX_NODES or the shm segment, join ignored\n", ev.node);
+				}
+				break;
+			}
+			while ( i >= (int)mp1.size() ) {
+				addNode();
+			}
+			// mp1Run starts the node this tick
+			if ( isLocal(i) && startTick[i] != par->getcurrtime() ) {
+				starting.push_back(i);
+				// a running node restarts: out of active until it has started again
+				activeDirty = activeDirty || startTick[i] >= 0;
+			}
+			startTick[i] = par->getcurrtime();
+			if ( ev.action == TL_RESTART && par->TRANSPORT == TRANSPORT_SHM && worker < 0 ) {
+				((ShmNet *)en)->markFailed(ev.node, false);
+			}
+			break;
+		case TL_CRASH:
+		case TL_LEAVE:
+			if ( i >= (int)mp1.size() || startTick[i] < 0 ) {
+				break;
+			}
+			metrics->recordFailure(mp1[i].getMemberNode().addr().getNodeId(), par->getcurrtime());
+			if ( !isLocal(i) ) {
+				break;
+			}
+			#ifdef DEBUGLOG
+			if ( ev.action == TL_CRASH ) {
+				log->LOG(&mp1[i].getMemberNode().addr(), "Node failed at time=%d", par->getcurrtime());
+			}
+			else {
+				log->LOG(&mp1[i].getMemberNode().addr(), "Node left at time=%d", par->getcurrtime());
+			}
+			#endif
+			if ( ev.action == TL_LEAVE ) {
+				mp1[i].finishUpThisNode();
+			}
+			failNode(i);
+			break;
+		case TL_DROP:
+			par->MSG_DROP_PROB = ev.value;
+			par->dropmsg = ev.value > 0;
+			break;
+		case TL_PARTITION:
+			for ( id = 1; id <= (int)mp1.size(); id++ ) {
+				en->setPartition(id, id < (int)ev.labels.size() ? ev.labels[id] : 0);
+			}
+			metrics->recordPartition(par->getcurrtime());
+			break;
+		case TL_HEAL:
+			for ( id = 1; id <= (int)mp1.size(); id++ ) {
+				en->setPartition(id, 0);
+			}
+			metrics->recordHeal(par->getcurrtime());
+			break;
+		case TL_LINKLOSS:
+			en->setLinkLoss(ev.src, ev.dst, ev.value);
+			break;
 	}
+}
 
+/**
+ * FUNCTION NAME: sampleViews
+ *
+ * DESCRIPTION: Churn runs: check every running node's view against the ground truth.
+ * 				Only the entries a node still believes alive (heard of within TFAIL) count.
+ */
+void Application::sampleViews() {
+	if ( par->CHURN_RATE <= 0 ) {
+		return;
+	}
+	for ( size_t a = 0; a < active.size(); a++ ) {
+		Member m = mp1[active[a]].getMemberNode();
+		// this tick's crashes leave active on the next pass
+		if ( m.isFailed() ) {
+			continue;
+		}
+		int entries = 0, alive = 0;
+		MemberList view = m.memberList();
+		const uint64_t *failed = view.staleMask(m.heartbeat() - TFAIL);
+		for ( size_t k = 1; k < view.size(); k++ ) {
+			if ( maskTest(failed, k) ) {
+				continue;
+			}
+			entries++;
+			size_t j = view.id(k) - 1;
+			if ( j < mp1.size() && startTick[j] >= 0 && !nodes->isFailed(j) ) {
+				alive++;
+			}
+		}
+		metrics->recordView(par->getcurrtime(), entries, alive);
+	}
 }
 
 /**
@@ -208,10 +801,6 @@ void Application::fail() {
  */
 Address Application::getjoinaddr(void){
 	//trace.funcEntry("Application::getjoinaddr");
-    Address joinaddr;
-    joinaddr.init();
-    *(int *)(&(joinaddr.addr))=1;
-    *(short *)(&(joinaddr.addr[4]))=0;
     //trace.funcExit("Application::getjoinaddr", SUCCESS);
-    return joinaddr;
+    return Address(NodeId(1, 0));
 }
@@ -13,18 +13,25 @@
 #include "Params.h"
 #include "Member.h"
 #include "EmulNet.h"
+#include "UdpNet.h"
+#include "ShmNet.h"
+#include <sys/wait.h>
 #include "Queue.h"
-
-/**
- * global variables
- */
-int nodeCount = 0;
+#include "Metrics.h"
+#include "Churn.h"
+#include <sys/stat.h>
 
 /*
  * Macros
  */
 #define ARGS_COUNT 2
+// optional third argument: id of the only node this process runs
+#define ARGS_COUNT_LOCAL 3
 #define TOTAL_RUNNING_TIME 700
+// written at the end of every CHECKPOINT_AT tick, with the run's LOG_PREFIX
+#define CHECKPOINT_FILE "checkpoint.%d.bin"
+// view changes of every node with MEMBER_EVENTS
+#define EVENTS_LOG "events.log"
 
 /**
  * CLASS NAME: Application
@@ -36,17 +43,69 @@ private:
 	// Address for introduction to the group
 	// Coordinator Node
 	char JOINADDR[30];
-	EmulNet *en;
+	Transport *en;
     Log *log;
-	MP1Node **mp1;
+	Metrics *metrics;
+	// state of every node, indexed by node id - 1; grows when the timeline joins new ids
+	NodeStore *nodes;
+	// protocol handles over the rows of nodes
+	vector<MP1Node> mp1;
+	// tick node i was (re)started at, -1 while it has not joined
+	vector<int> startTick;
+	// local nodes running since an earlier tick and not failed, ascending
+	vector<int> active;
+	// local nodes (re)started this tick, moved into active at the end of mp1Run
+	vector<int> starting;
+	// a node of active failed or restarted since active was last compacted
+	bool activeDirty;
 	Params *par;
+	// rand_r state of the failure injection
+	unsigned int failRandState;
+	// shm transport: number of worker processes, this process's worker index (-1 = coordinator)
+	int workers;
+	int worker;
+	vector<pid_t> workerPids;
+	int liveWorkers;
+	// shm: a worker whose nodes all failed can be killed (no restart events)
+	bool killDeadWorkers;
+	// first tick run() simulates: 0, or the tick after a restored checkpoint
+	int firstTick;
+	// TRACE_RECORD / TRACE_REPLAY, NULL when neither is set
+	Trace *trace;
+	// wall clock of firstTick, for TICK_MS
+	struct timespec tickStart;
+	MetricsSummary summary;
+	// EVENTS_LOG, opened by the first drainEvents
+	FILE *eventsLog;
+#ifdef PROFILE
+	Profiler profiler;
+#endif
+	void addNode();
+	void buildDefaultTimeline();
+	void applyEvents(bool beforeRun);
+	void applyEvent(TimelineEvent &ev);
+	void sampleViews();
+	void runWorkers();
+	void workerLoop();
+	void failNode(int i);
+	void compactActive();
+	void rebuildActive();
+	bool checkpoint(Checkpoint &ck);
+	void saveCheckpoint();
+	void restoreCheckpoint();
+	void drainEvents();
 public:
-	Application(char *);
+	Application(char *, int localNode = 0, const vector<string> &settings = vector<string>());
 	virtual ~Application();
 	Address getjoinaddr();
+	bool isLocal(int i);
+	void waitForTick();
 	int run();
 	void mp1Run();
 	void fail();
+	const MetricsSummary &getSummary() {
+		return summary;
+	}
 };
 
 #endif /* _APPLICATION_H__ */
@@ -0,0 +1,199 @@
+/**********************************
+ * FILE NAME: Batch.cpp
+ *
+ * DESCRIPTION: Definition of the multi-scenario Batch runner
+ **********************************/
+
+#include "Batch.h"
+#include "Application.h"
+
+/**
+ * Constructor
+ */
+Batch::Batch(): next(0), threads(0), outdir(BATCH_DIR) {}
+
+/**
+ * FUNCTION NAME: parseArgs
+ *
+ * DESCRIPTION: Read the options, conf files and grid axes (the arguments after -batch)
+ * 				and lay out one run per conf file and grid point
+ *
+ * RETURNS:
+ * false if there is nothing to run or an argument is bad
+ */
+bool Batch::parseArgs(int argc, char *argv[]) {
+	vector<string> confs;
+	vector<pair<string, vector<string> > > axes;
+	int i;
+
+	for ( i = 0; i < argc; i++ ) {
+		const char *eq = strchr(argv[i], '=');
+		if ( !strcmp(argv[i], "-j") && i + 1 < argc ) {
+			threads = atoi(argv[++i]);
+		}
+		else if ( !strcmp(argv[i], "-o") && i + 1 < argc ) {
+			outdir = argv[++i];
+		}
+		else if ( eq != NULL ) {
+			// KEY=v1,v2,...
+			vector<string> values;
+			string list(eq + 1);
+			size_t start = 0, comma;
+			while ( (comma = list.find(',', start)) != string::npos ) {
+				values.push_back(list.substr(start, comma - start));
+				start = comma + 1;
+			}
+			values.push_back(list.substr(start));
+			axes.push_back(make_pair(string(argv[i], eq - argv[i]), values));
+		}
+		else if ( access(argv[i], R_OK) == 0 ) {
+			confs.push_back(argv[i]);
+		}
+		else {
+			printf("Cannot read conf file %s\n", argv[i]);
+			return false;
+		}
+	}
+	if ( confs.empty() ) {
+		return false;
+	}
+	if ( threads <= 0 ) {
+		threads = max(1u, thread::hardware_concurrency());
+	}
+
+	for ( size_t c = 0; c < confs.size(); c++ ) {
+		// odometer over the axes
+		vector<size_t> point(axes.size(), 0);
+		do {
+			BatchRun run;
+			char dir[64];
+			string base = confs[c].substr(confs[c].find_last_of('/') + 1);
+			run.conf = confs[c];
+			for ( size_t a = 0; a < axes.size(); a++ ) {
+				const string &value = axes[a].second[point[a]];
+				run.settings.push_back(axes[a].first + ": " + value);
+				run.label += (a ? " " : "") + axes[a].first + "=" + value;
+			}
+			snprintf(dir, sizeof(dir), "/%zu-", runs.size());
+			run.outdir = outdir + dir + base.substr(0, base.rfind(".conf"));
+			run.settings.push_back("OUTDIR: " + run.outdir);
+			memset(&run.summary, 0, sizeof(run.summary));
+			run.seconds = 0;
+			run.done = false;
+
+			Params p;
+			p.setparams((char *)run.conf.c_str(), run.settings);
+			if ( p.TRANSPORT != TRANSPORT_EMUL ) {
+				printf("%s %s: only the emul transport runs in a batch, skipped\n", run.conf.c_str(), run.label.c_str());
+			}
+			else {
+				runs.push_back(run);
+			}
+
+			size_t a = 0;
+			while ( a < axes.size() && ++point[a] == axes[a].second.size() ) {
+				point[a++] = 0;
+			}
+			if ( a == axes.size() ) {
+				break;
+			}
+		} while ( true );
+	}
+	return !runs.empty();
+}
+
+/**
+ * FUNCTION NAME: work
+ *
+ * DESCRIPTION: Body of a pool thread: take the next run until there is none left
+ */
+void Batch::work() {
+	size_t i;
+	struct timespec start, end;
+
+	while ( (i = next++) < runs.size() ) {
+		BatchRun &run = runs[i];
+		vector<char> conf(run.conf.begin(), run.conf.end());
+		conf.push_back(0);
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		Application *app = new Application(conf.data(), 0, run.settings);
+		app->run();
+		run.summary = app->getSummary();
+		delete app;
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		run.seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+		run.done = true;
+	}
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Run every simulation on min(threads, runs) threads. The runs' chatter on stdout
+ * 				is sent to /dev/null meanwhile; their logs are in their OUTDIRs.
+ */
+void Batch::run() {
+	vector<thread> pool;
+	int saved, devnull;
+
+	mkdir(outdir.c_str(), 0755);
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	devnull = open("/dev/null", O_WRONLY);
+	if ( devnull >= 0 ) {
+		dup2(devnull, STDOUT_FILENO);
+		close(devnull);
+	}
+
+	next = 0;
+	for ( int t = 0; t < min(threads, (int)runs.size()); t++ ) {
+		pool.push_back(thread(&Batch::work, this));
+	}
+	for ( size_t t = 0; t < pool.size(); t++ ) {
+		pool[t].join();
+	}
+
+	fflush(stdout);
+	if ( saved >= 0 ) {
+		dup2(saved, STDOUT_FILENO);
+		close(saved);
+	}
+}
+
+/**
+ * FUNCTION NAME: printSummary
+ *
+ * DESCRIPTION: One line per run with its headline metrics
+ */
+void Batch::printSummary(FILE *fp) {
+	fprintf(fp, "%4s %-28s %-30s %7s %6s %8s %9s %9s %6s %10s %7s\n", "run", "conf", "settings", "started", "failed",
+			"detect%", "false_rm", "join_mean", "unconv", "bytes", "secs");
+	for ( size_t i = 0; i < runs.size(); i++ ) {
+		BatchRun &run = runs[i];
+		MetricsSummary &s = run.summary;
+		fprintf(fp, "%4zu %-28s %-30s ", i, run.conf.c_str(), run.label.empty() ? "-" : run.label.c_str());
+		if ( !run.done ) {
+			fprintf(fp, "did not finish\n");
+			continue;
+		}
+		fprintf(fp, "%7d %6d %8.1f %9d %9.1f %6d %10lld %7.2f\n", s.started, s.failed,
+				s.expectedDetections ? 100.0 * s.detections / s.expectedDetections : 0.0, s.falseRemovals,
+				s.joinMean, s.unconverged, s.bytesSent, run.seconds);
+	}
+}
+
+/**
+ * FUNCTION NAME: writeSummary
+ *
+ * DESCRIPTION: Print the summary table and keep a copy in the batch directory
+ */
+void Batch::writeSummary() {
+	FILE *fp = fopen((outdir + "/" + BATCH_SUMMARY).c_str(), "w");
+
+	printSummary(stdout);
+	if ( fp != NULL ) {
+		printSummary(fp);
+		fclose(fp);
+	}
+}
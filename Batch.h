@@ -0,0 +1,62 @@
+/**********************************
+ * FILE NAME: Batch.h
+ *
+ * DESCRIPTION: Header file of the multi-scenario Batch runner
+ **********************************/
+
+#ifndef _BATCH_H_
+#define _BATCH_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Metrics.h"
+#include <atomic>
+#include <thread>
+
+#define BATCH_FLAG "-batch"
+#define BATCH_DIR "batch"
+#define BATCH_SUMMARY "summary.txt"
+
+/**
+ * STRUCT NAME: BatchRun
+ *
+ * DESCRIPTION: One simulation of a batch: a conf file plus one point of the parameter grid
+ */
+typedef struct BatchRun {
+	string conf;
+	// "KEY: value" lines of the grid point, then the run's OUTDIR
+	vector<string> settings;
+	// "KEY=value ..." of the grid point, for the summary
+	string label;
+	string outdir;
+	MetricsSummary summary;
+	double seconds;
+	bool done;
+}BatchRun;
+
+/**
+ * CLASS NAME: Batch
+ *
+ * DESCRIPTION: Runs many independent simulations in one process on a pool of threads.
+ * 				"./Application -batch [-j threads] [-o dir] a.conf b.conf KEY=v1,v2 ..."
+ * 				runs every conf file at every point of the grid spanned by the KEY=values
+ * 				arguments. Each run has its own Application (Params, EmulNet, Log, Metrics,
+ * 				profiler) and writes its logs to dir/<n>-<conf>; the summary table goes
+ * 				to stdout and dir/summary.txt. Only the emul transport can run in a batch.
+ */
+class Batch {
+private:
+	vector<BatchRun> runs;
+	atomic<size_t> next;
+	int threads;
+	string outdir;
+	void work();
+public:
+	Batch();
+	bool parseArgs(int argc, char *argv[]);
+	void run();
+	void printSummary(FILE *fp);
+	void writeSummary();
+};
+
+#endif /* _BATCH_H_ */
@@ -0,0 +1,102 @@
+/**********************************
+ * FILE NAME: Checkpoint.cpp
+ *
+ * DESCRIPTION: Definition of the binary simulation Checkpoint
+ **********************************/
+
+#include "Checkpoint.h"
+
+/**
+ * Constructor
+ */
+Checkpoint::Checkpoint(): fp(NULL), writing(false), ok(false) {}
+
+/**
+ * Destructor
+ */
+Checkpoint::~Checkpoint() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Open file for writing or reading and write or check the magic
+ *
+ * RETURNS:
+ * false if the file cannot be opened or is not a checkpoint
+ */
+bool Checkpoint::open(const char *file, bool write) {
+	char magic[sizeof(CHECKPOINT_MAGIC)];
+
+	close();
+	writing = write;
+	fp = fopen(file, write ? "wb" : "rb");
+	ok = fp != NULL;
+	memcpy(magic, CHECKPOINT_MAGIC, sizeof(magic));
+	bytes(magic, sizeof(magic));
+	if ( ok && !write && memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ) {
+		ok = false;
+	}
+	return ok;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Flush and close the file
+ */
+void Checkpoint::close() {
+	if ( fp != NULL ) {
+		if ( fclose(fp) != 0 ) {
+			ok = false;
+		}
+		fp = NULL;
+	}
+}
+
+/**
+ * FUNCTION NAME: bytes
+ *
+ * DESCRIPTION: Write size bytes from data, or read them into data. After the first
+ * 				failure nothing more is transferred and good() stays false.
+ */
+void Checkpoint::bytes(void *data, size_t size) {
+	if ( !ok || size == 0 ) {
+		return;
+	}
+	if ( writing ) {
+		ok = fwrite(data, 1, size, fp) == size;
+	}
+	else {
+		ok = fread(data, 1, size, fp) == size;
+	}
+}
+
+/**
+ * FUNCTION NAME: rng
+ *
+ * DESCRIPTION: Save or load the full state of a Mersenne Twister through its text form
+ */
+void Checkpoint::rng(mt19937 &r) {
+	string state;
+
+	if ( !loading() ) {
+		ostringstream out;
+		out << r;
+		state = out.str();
+	}
+	uint64_t n = state.size();
+	pod(n);
+	if ( loading() ) {
+		state.resize(ok ? n : 0);
+	}
+	if ( !state.empty() ) {
+		bytes(&state[0], state.size());
+	}
+	if ( loading() && ok ) {
+		istringstream in(state);
+		in >> r;
+		ok = !in.fail();
+	}
+}
@@ -0,0 +1,84 @@
+/**********************************
+ * FILE NAME: Checkpoint.h
+ *
+ * DESCRIPTION: Header file of the binary simulation Checkpoint
+ **********************************/
+
+#ifndef _CHECKPOINT_H_
+#define _CHECKPOINT_H_
+
+#include "stdincludes.h"
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <type_traits>
+
+#define CHECKPOINT_MAGIC "MP1CKPT1"
+
+/**
+ * CLASS NAME: Checkpoint
+ *
+ * DESCRIPTION: Binary checkpoint file, read or written through the same calls: each class
+ * 				lists its state once in a checkpoint(Checkpoint &) method, which saves it
+ * 				when the file was opened for writing and loads it otherwise.
+ * 				Values are raw host-endian bytes; a checkpoint is only read back by the same build.
+ */
+class Checkpoint {
+private:
+	FILE *fp;
+	bool writing;
+	bool ok;
+public:
+	Checkpoint();
+	virtual ~Checkpoint();
+	bool open(const char *file, bool write);
+	void close();
+	bool loading() {
+		return !writing;
+	}
+	bool good() {
+		return ok;
+	}
+	void bytes(void *data, size_t size);
+	template<typename T> void pod(T &value) {
+		static_assert(is_trivially_copyable<T>::value, "Checkpoint::pod needs a trivially copyable type");
+		bytes(&value, sizeof(T));
+	}
+	template<typename A, typename B> void pod(pair<A, B> &value) {
+		pod(value.first);
+		pod(value.second);
+	}
+	template<typename T, typename A> void podVector(vector<T, A> &v) {
+		uint64_t n = v.size();
+		pod(n);
+		if ( loading() ) {
+			v.resize(ok ? n : 0);
+		}
+		if ( !v.empty() ) {
+			bytes(&v[0], v.size() * sizeof(T));
+		}
+	}
+	template<typename K, typename V, typename H> void podMap(unordered_map<K, V, H> &m) {
+		uint64_t n = m.size();
+		pod(n);
+		if ( !loading() ) {
+			for ( typename unordered_map<K, V, H>::iterator it = m.begin(); it != m.end(); it++ ) {
+				K k = it->first;
+				pod(k);
+				pod(it->second);
+			}
+			return;
+		}
+		m.clear();
+		for ( uint64_t i = 0; i < n && ok; i++ ) {
+			K k;
+			V v;
+			pod(k);
+			pod(v);
+			m[k] = v;
+		}
+	}
+	void rng(mt19937 &r);
+};
+
+#endif /* _CHECKPOINT_H_ */
@@ -0,0 +1,102 @@
+/**********************************
+ * FILE NAME: Churn.cpp
+ *
+ * DESCRIPTION: Definition of the continuous churn workload generator
+ **********************************/
+
+#include "Churn.h"
+
+/**
+ * Constructor
+ */
+ChurnGenerator::ChurnGenerator(Params *p, unsigned int seed): par(p), rng(seed) {}
+
+/**
+ * FUNCTION NAME: generate
+ *
+ * DESCRIPTION: Add the churn events up to endTime to tl. Node state before CHURN_START is replayed
+ * 				from the events already in tl, so scripted and canned failures are taken into account.
+ * 				New ids start after the highest id in tl and stop at maxNodes.
+ *
+ * RETURNS:
+ * number of events added
+ */
+int ChurnGenerator::generate(Timeline &tl, int endTime, int maxNodes) {
+	// 0 = never started, 1 = up, -1 = down
+	vector<int> state(maxNodes + 1, 0);
+	// tick each down node went down; a restart in that same tick would run before the crash
+	vector<int> downAt(maxNodes + 1, -1);
+	vector<int> up, down;
+	exponential_distribution<double> gap(par->CHURN_RATE);
+	uniform_real_distribution<double> coin(0, 1);
+	TimelineEvent ev;
+	int nextId = par->EN_GPSZ + 1;
+	int added = 0;
+	size_t k, pick;
+
+	for ( k = 0; k < tl.size(); k++ ) {
+		const TimelineEvent &e = tl.at(k);
+		if ( e.node < 1 || e.node > maxNodes ) {
+			continue;
+		}
+		nextId = max(nextId, e.node + 1);
+		if ( e.time >= par->CHURN_START ) {
+			continue;
+		}
+		if ( e.action == TL_JOIN || e.action == TL_RESTART ) {
+			state[e.node] = 1;
+		}
+		else if ( (e.action == TL_CRASH || e.action == TL_LEAVE) && state[e.node] ) {
+			state[e.node] = -1;
+		}
+	}
+	for ( int id = 2; id <= maxNodes; id++ ) {
+		if ( state[id] == 1 ) {
+			up.push_back(id);
+		}
+		else if ( state[id] == -1 ) {
+			down.push_back(id);
+		}
+	}
+
+	ev.src = ev.dst = 0;
+	ev.value = 0;
+	for ( double t = par->CHURN_START + gap(rng); t < endTime; t += gap(rng) ) {
+		ev.time = (int)t;
+		bool join = coin(rng) < par->CHURN_JOIN && nextId <= maxNodes;
+		bool restart = false;
+		if ( !join && !down.empty() && (up.empty() || coin(rng) < 0.5) ) {
+			pick = uniform_int_distribution<size_t>(0, down.size() - 1)(rng);
+			restart = downAt[down[pick]] < ev.time;
+		}
+
+		if ( join ) {
+			ev.action = TL_JOIN;
+			ev.node = nextId++;
+			up.push_back(ev.node);
+		}
+		else if ( restart ) {
+			ev.action = TL_RESTART;
+			ev.node = down[pick];
+			down[pick] = down.back();
+			down.pop_back();
+			up.push_back(ev.node);
+		}
+		else if ( !up.empty() ) {
+			pick = uniform_int_distribution<size_t>(0, up.size() - 1)(rng);
+			ev.action = TL_CRASH;
+			ev.node = up[pick];
+			up[pick] = up.back();
+			up.pop_back();
+			down.push_back(ev.node);
+			downAt[ev.node] = ev.time;
+		}
+		else {
+			continue;
+		}
+		tl.add(ev);
+		added++;
+	}
+	tl.sort();
+	return added;
+}
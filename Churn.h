@@ -0,0 +1,35 @@
+/**********************************
+ * FILE NAME: Churn.h
+ *
+ * DESCRIPTION: Header file of the continuous churn workload generator
+ **********************************/
+
+#ifndef _CHURN_H_
+#define _CHURN_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Timeline.h"
+#include <random>
+
+#define CHURN_LOG "churn.log"
+
+/**
+ * CLASS NAME: ChurnGenerator
+ *
+ * DESCRIPTION: Turns CHURN_RATE into timeline events. Churn events arrive as a Poisson process
+ * 				(exponential gaps, CHURN_RATE per tick on average) between CHURN_START and the end tick.
+ * 				A CHURN_JOIN fraction of them joins a brand-new node id; the rest crash a running
+ * 				node or restart a crashed one, so the group size stays level. The introducer
+ * 				(id 1) is never crashed, otherwise nobody could join any more.
+ */
+class ChurnGenerator {
+private:
+	Params *par;
+	mt19937 rng;
+public:
+	ChurnGenerator(Params *p, unsigned int seed);
+	int generate(Timeline &tl, int endTime, int maxNodes);
+};
+
+#endif /* _CHURN_H_ */
@@ -0,0 +1,31 @@
+#**********************
+#*
+#* Progam Name: MP1. Membership Protocol.
+#*
+#* Current file: DeltaCheck.sh
+#* About this file: Push-pull delta check.
+#*
+#***********************
+#!/bin/bash
+
+# testcases/pushpull.conf splits a zone of 30 in halves for 8 ticks: after the heal every view
+# misses the fresh heartbeats of about 14 members, more than a DeltaMessage holds. Only if
+# DIGESTREP and DIGESTPUSH carry all of them in time does nobody get removed but the failed node.
+
+dir=$(mktemp -d)
+failed=0
+
+make > /dev/null || exit 1
+for seed in 1 2 3 4 5; do
+	(echo "OUTDIR: $dir"; echo "SEED: $seed"; cat testcases/pushpull.conf) > $dir/run.conf
+	./Application $dir/run.conf > /dev/null
+	removals=$(grep "false removals" $dir/metrics.log)
+	if ! echo "$removals" | grep -q "false removals *0 of"; then
+		echo "FAIL SEED $seed: $removals"
+		failed=1
+	else
+		echo "ok   SEED $seed"
+	fi
+done
+rm -rf $dir
+exit $failed
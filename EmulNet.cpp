@@ -12,57 +12,454 @@
 EmulNet::EmulNet(Params *p)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
 	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
+	sent_bytes = 0;
+	sent_count = 0;
+	inbox_overflows = 0;
+	partition_drops = 0;
+	linkloss_drops = 0;
+	trace = NULL;
+	unsigned int seed = par->SEED ? par->SEED : (unsigned int)time(NULL);
+	delayRng.seed(seed);
+	dropRng.seed(seed + 1);
+	emulnet.inboxlimit = par->INBOX_LIMIT;
+	// calloc hands back zeroed pages lazily instead of touching ~29 MB up front
+	sent_msgs = (int (*)[MAX_TIME]) calloc(MAX_NODES + 1, sizeof(*sent_msgs));
+	recv_msgs = (int (*)[MAX_TIME]) calloc(MAX_NODES + 1, sizeof(*recv_msgs));
+	if ( sent_msgs == NULL || recv_msgs == NULL ) {
+		perror("calloc message counts");
+		exit(1);
 	}
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
 
 /**
- * Copy constructor
+ * Move constructor
+ * Takes over the counters and the in-flight messages; anotherEmulNet is left empty
  */
-EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
+EmulNet::EmulNet(EmulNet &&anotherEmulNet): emulnet(std::move(anotherEmulNet.emulnet)) {
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
+	this->sent_bytes = anotherEmulNet.sent_bytes;
+	this->sent_count = anotherEmulNet.sent_count;
+	this->inbox_overflows = anotherEmulNet.inbox_overflows;
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
+	this->delayRng = anotherEmulNet.delayRng;
+	this->dropRng = anotherEmulNet.dropRng;
+	this->partition = std::move(anotherEmulNet.partition);
+	this->linkLoss = std::move(anotherEmulNet.linkLoss);
+	this->partition_drops = anotherEmulNet.partition_drops;
+	this->linkloss_drops = anotherEmulNet.linkloss_drops;
+	this->nodes = std::move(anotherEmulNet.nodes);
+	this->trace = anotherEmulNet.trace;
+	anotherEmulNet.trace = NULL;
+	anotherEmulNet.sent_msgs = NULL;
+	anotherEmulNet.recv_msgs = NULL;
+}
+
+/**
+ * Move assignment operator overloading
+ */
+EmulNet& EmulNet::operator =(EmulNet &&anotherEmulNet) {
+	swap(this->par, anotherEmulNet.par);
+	swap(this->enInited, anotherEmulNet.enInited);
+	swap(this->sent_bytes, anotherEmulNet.sent_bytes);
+	swap(this->sent_count, anotherEmulNet.sent_count);
+	swap(this->inbox_overflows, anotherEmulNet.inbox_overflows);
+	swap(this->sent_msgs, anotherEmulNet.sent_msgs);
+	swap(this->recv_msgs, anotherEmulNet.recv_msgs);
+	swap(this->delayRng, anotherEmulNet.delayRng);
+	swap(this->dropRng, anotherEmulNet.dropRng);
+	swap(this->partition, anotherEmulNet.partition);
+	swap(this->linkLoss, anotherEmulNet.linkLoss);
+	swap(this->partition_drops, anotherEmulNet.partition_drops);
+	swap(this->linkloss_drops, anotherEmulNet.linkloss_drops);
+	swap(this->nodes, anotherEmulNet.nodes);
+	swap(this->trace, anotherEmulNet.trace);
+	this->emulnet = std::move(anotherEmulNet.emulnet);
+	return *this;
+}
+
+/**
+ * Destructor
+ */
+EmulNet::~EmulNet() {
+	free(sent_msgs);
+	free(recv_msgs);
+}
+
+/**
+ * FUNCTION NAME: push
+ *
+ * DESCRIPTION: File a message under its delivery tick
+ */
+void EM::push(const en_msg &msg) {
+	currbuffsize++;
+	if ( msg.due <= wheeltick ) {
+		deliver(msg);
+	}
+	else if ( msg.due - wheeltick <= DELAY_WHEEL_SLOTS ) {
+		wheel[msg.due % DELAY_WHEEL_SLOTS].push_back(msg);
+	}
+	else {
+		overflow.push(msg);
+	}
+}
+
+/**
+ * FUNCTION NAME: advance
+ *
+ * DESCRIPTION: Move everything due up to tick into the ready queues of the destinations
+ */
+void EM::advance(int tick) {
+	while ( wheeltick < tick ) {
+		wheeltick++;
+		vector<en_msg> &slot = wheel[wheeltick % DELAY_WHEEL_SLOTS];
+		for ( size_t i = 0; i < slot.size(); i++ ) {
+			deliver(slot[i]);
+		}
+		slot.clear();
+		while ( !overflow.empty() && overflow.top().due <= wheeltick ) {
+			deliver(overflow.top());
+			overflow.pop();
 		}
 	}
-	this->emulnet = anotherEmulNet.emulnet;
 }
 
 /**
- * Assignment operator overloading
+ * FUNCTION NAME: deliver
+ *
+ * DESCRIPTION: Append a due message to the ready queue of its destination, or drop it
+ * 				if that queue already holds inboxlimit messages
  */
-EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
-	this->par = anotherEmulNet.par;
-	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
+void EM::deliver(const en_msg &msg) {
+	int id = msg.to.getid();
+	deque<en_msg> &q = readyFor(id);
+
+	if ( inboxlimit > 0 && (int)q.size() >= inboxlimit ) {
+		if ( id >= (int)inboxdrops.size() ) {
+			inboxdrops.resize(id + 1, 0);
 		}
+		inboxdrops[id]++;
+		releasePayload(msg.payload);
+		currbuffsize--;
+		return;
 	}
-	this->emulnet = anotherEmulNet.emulnet;
-	return *this;
+	q.push_back(msg);
 }
 
 /**
- * Destructor
+ * FUNCTION NAME: readyFor
+ *
+ * DESCRIPTION: Ready queue of node id
  */
-EmulNet::~EmulNet() {}
+deque<en_msg> &EM::readyFor(int id) {
+	if ( id >= (int)ready.size() ) {
+		ready.resize(id + 1);
+	}
+	return ready[id];
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Drop every in-flight message
+ */
+void EM::clear() {
+	for ( size_t i = 0; i < wheel.size(); i++ ) {
+		for ( size_t j = 0; j < wheel[i].size(); j++ ) {
+			releasePayload(wheel[i][j].payload);
+		}
+		wheel[i].clear();
+	}
+	for ( size_t i = 0; i < ready.size(); i++ ) {
+		for ( size_t j = 0; j < ready[i].size(); j++ ) {
+			releasePayload(ready[i][j].payload);
+		}
+		ready[i].clear();
+	}
+	while ( !overflow.empty() ) {
+		releasePayload(overflow.top().payload);
+		overflow.pop();
+	}
+	currbuffsize = 0;
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load every message in flight with its delivery tick and the clock of the wheel.
+ * 				Each descriptor is saved with its own copy of the payload, so loading does not share them.
+ */
+void EM::checkpoint(Checkpoint &ck) {
+	vector<en_msg> msgs;
+	uint64_t n;
+
+	ck.pod(nextid);
+	ck.pod(firsteltindex);
+	ck.pod(wheeltick);
+	ck.podVector(inboxdrops);
+	if ( !ck.loading() ) {
+		// ready queues first, in order, then whatever is still on its way
+		for ( size_t i = 0; i < ready.size(); i++ ) {
+			msgs.insert(msgs.end(), ready[i].begin(), ready[i].end());
+		}
+		for ( size_t i = 0; i < wheel.size(); i++ ) {
+			msgs.insert(msgs.end(), wheel[i].begin(), wheel[i].end());
+		}
+		priority_queue<en_msg, vector<en_msg>, en_msg_later> later = overflow;
+		for ( ; !later.empty(); later.pop() ) {
+			msgs.push_back(later.top());
+		}
+	}
+	else {
+		int tick = wheeltick;
+		clear();
+		wheeltick = tick;
+	}
+
+	n = msgs.size();
+	ck.pod(n);
+	for ( uint64_t i = 0; i < n && ck.good(); i++ ) {
+		en_msg msg;
+		int size;
+		if ( !ck.loading() ) {
+			msg = msgs[i];
+			size = msg.payload->size;
+		}
+		ck.pod(msg.from.key);
+		ck.pod(msg.to.key);
+		ck.pod(msg.due);
+		ck.pod(size);
+		if ( !ck.good() ) {
+			break;
+		}
+		if ( ck.loading() ) {
+			msg.payload = (en_payload *)malloc(sizeof(en_payload) + size);
+			msg.payload->refs = 1;
+			msg.payload->size = size;
+		}
+		ck.bytes(msg.payload + 1, size);
+		if ( ck.loading() ) {
+			// with inboxlimit unchanged, due messages all fit back into their ready queue
+			push(msg);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load the messages in flight, the traffic counters up to the current tick,
+ * 				the RNGs, the network faults in force and the token buckets
+ *
+ * RETURNS:
+ * true
+ */
+bool EmulNet::checkpoint(Checkpoint &ck) {
+	int ids = emulnet.nextid;
+	int ticks = par->getcurrtime() + 1;
+
+	emulnet.checkpoint(ck);
+	ck.pod(ids);
+	ck.pod(ticks);
+	for ( int i = 0; i < min(ids, MAX_NODES + 1); i++ ) {
+		ck.bytes(sent_msgs[i], min(ticks, MAX_TIME) * sizeof(int));
+		ck.bytes(recv_msgs[i], min(ticks, MAX_TIME) * sizeof(int));
+	}
+	ck.pod(sent_bytes);
+	ck.pod(sent_count);
+	ck.pod(inbox_overflows);
+	ck.pod(partition_drops);
+	ck.pod(linkloss_drops);
+	ck.rng(delayRng);
+	ck.rng(dropRng);
+	ck.podVector(partition);
+	ck.podMap(linkLoss);
+	ck.podVector(nodes);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: nodeAt
+ *
+ * DESCRIPTION: Counters of node id with its token buckets refilled up to time.
+ * 				A bucket holds up to max(BURST, RATE, 1) tokens and starts full.
+ */
+en_node &EmulNet::nodeAt(int id, int time) {
+	double sendCap = max(par->SEND_BURST, max(par->SEND_RATE, 1.0));
+	double recvCap = max(par->RECV_BURST, max(par->RECV_RATE, 1.0));
+
+	if ( id >= (int)nodes.size() ) {
+		en_node fresh;
+		memset(&fresh, 0, sizeof(fresh));
+		fresh.refilled = -1;
+		nodes.resize(id + 1, fresh);
+	}
+	en_node &n = nodes[id];
+	if ( n.refilled < 0 ) {
+		n.sendTokens = sendCap;
+		n.recvTokens = recvCap;
+	}
+	else if ( n.refilled < time ) {
+		n.sendTokens = min(sendCap, n.sendTokens + par->SEND_RATE * (time - n.refilled));
+		n.recvTokens = min(recvCap, n.recvTokens + par->RECV_RATE * (time - n.refilled));
+	}
+	n.refilled = time;
+	return n;
+}
+
+/**
+ * FUNCTION NAME: delayOf
+ *
+ * DESCRIPTION: Extra ticks a message from src to dst spends in flight under DELAY_MODEL
+ */
+int EmulNet::delayOf(int src, int dst) {
+	switch ( par->DELAY_MODEL ) {
+		case DELAY_FIXED:
+			return par->DELAY_MIN;
+		case DELAY_UNIFORM:
+			return uniform_int_distribution<int>(par->DELAY_MIN, max(par->DELAY_MIN, par->DELAY_MAX))(delayRng);
+		case DELAY_LOGNORMAL: {
+			double d = lognormal_distribution<double>(par->DELAY_MU, par->DELAY_SIGMA)(delayRng);
+			return par->DELAY_MIN + (int)min(d, (double)MAX_TIME);
+		}
+		case DELAY_LINK: {
+			// every directed link keeps its own base delay for the whole run
+			NodeId link;
+			link.key = ((uint64_t)(uint32_t)src << 32) | (uint32_t)dst;
+			int base = par->DELAY_MIN + (int)(link.hash() % (max(par->DELAY_MAX - par->DELAY_MIN, 0) + 1));
+			return base + uniform_int_distribution<int>(0, max(par->DELAY_JITTER, 0))(delayRng);
+		}
+		default:
+			return 0;
+	}
+}
+
+/**
+ * FUNCTION NAME: setPartition
+ *
+ * DESCRIPTION: Put node id in partition label; all labels 0 means no partition
+ */
+void EmulNet::setPartition(int id, int label) {
+	if ( id >= (int)partition.size() ) {
+		partition.resize(id + 1, 0);
+	}
+	partition[id] = label;
+}
+
+/**
+ * FUNCTION NAME: setLinkLoss
+ *
+ * DESCRIPTION: Drop messages from src to dst with probability prob, 0 restores the link
+ */
+void EmulNet::setLinkLoss(int src, int dst, double prob) {
+	uint64_t link = ((uint64_t)(uint32_t)src << 32) | (uint32_t)dst;
+	if ( prob <= 0 ) {
+		linkLoss.erase(link);
+	}
+	else {
+		linkLoss[link] = prob;
+	}
+}
+
+/**
+ * FUNCTION NAME: faultDrops
+ *
+ * DESCRIPTION: O(1) check of the partition labels and the overridden links
+ *
+ * RETURNS:
+ * TR_PARTITION, TR_LINKLOSS or TR_DELIVER
+ */
+int EmulNet::faultDrops(int src, int dst) {
+	int ls = src < (int)partition.size() ? partition[src] : 0;
+	int ld = dst < (int)partition.size() ? partition[dst] : 0;
+	if ( ls != ld ) {
+		return TR_PARTITION;
+	}
+	if ( !linkLoss.empty() ) {
+		unordered_map<uint64_t, double>::iterator it = linkLoss.find(((uint64_t)(uint32_t)src << 32) | (uint32_t)dst);
+		if ( it != linkLoss.end() && uniform_real_distribution<double>(0, 1)(dropRng) < it->second ) {
+			return TR_LINKLOSS;
+		}
+	}
+	return TR_DELIVER;
+}
+
+/**
+ * FUNCTION NAME: decide
+ *
+ * DESCRIPTION: Live run: draw what happens to a message from src to dst, and its delivery tick
+ *
+ * RETURNS:
+ * TraceVerdict
+ */
+int EmulNet::decide(int src, int dst, int time, int &due) {
+	int sendmsg = uniform_int_distribution<int>(0, 99)(dropRng);
+	int verdict;
+
+	if ( par->EN_BUFFSIZE > 0 && emulnet.currbuffsize >= par->EN_BUFFSIZE ) {
+		return TR_BUFFER;
+	}
+	if ( par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100) ) {
+		return TR_LOSS;
+	}
+	if ( (verdict = faultDrops(src, dst)) != TR_DELIVER ) {
+		return verdict;
+	}
+	if ( par->SEND_RATE > 0 ) {
+		en_node &sender = nodeAt(src, time);
+		if ( sender.sendTokens < 1 ) {
+			return TR_THROTTLE;
+		}
+		sender.sendTokens -= 1;
+	}
+	// sent this tick, received from the next one on at the earliest
+	due = time + 1 + delayOf(src, dst);
+	return TR_DELIVER;
+}
+
+/**
+ * FUNCTION NAME: countDrop
+ *
+ * DESCRIPTION: Charge a dropped message to its cause
+ */
+void EmulNet::countDrop(int verdict, int src, int dst, int time) {
+	switch ( verdict ) {
+		case TR_BUFFER:
+			nodeAt(dst, time).bufferDrops++;
+			break;
+		case TR_LOSS:
+			nodeAt(dst, time).lossDrops++;
+			break;
+		case TR_PARTITION:
+			partition_drops++;
+			break;
+		case TR_LINKLOSS:
+			linkloss_drops++;
+			break;
+		case TR_THROTTLE:
+			nodeAt(src, time).throttleDrops++;
+			break;
+	}
+}
+
+/**
+ * FUNCTION NAME: setTrace
+ *
+ * DESCRIPTION: Record every send and receive decision to trace, or take them from it
+ *
+ * RETURNS:
+ * true
+ */
+bool EmulNet::setTrace(Trace *trace) {
+	this->trace = trace;
+	return true;
+}
 
 /**
  * FUNCTION NAME: ENinit
@@ -71,8 +468,7 @@ EmulNet::~EmulNet() {}
  */
 void *EmulNet::ENinit(Address *myaddr, short port) {
 	// Initialize data structures for this member
-	*(int *)(myaddr->addr) = emulnet.nextid++;
-    *(short *)(&myaddr->addr[4]) = 0;
+	*myaddr = Address(NodeId(emulnet.nextid++, 0));
 	return myaddr;
 }
 
@@ -85,93 +481,137 @@ void *EmulNet::ENinit(Address *myaddr, short port) {
  * size
  */
 int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
-	en_msg *em;
-	static char temp[2048];
-	int sendmsg = rand() % 100;
+	return ENmulticast(myaddr, toaddr, 1, data, size) ? size : 0;
+}
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+/**
+ * FUNCTION NAME: ENmulticast
+ *
+ * DESCRIPTION: Send one message to count targets. The payload is copied once and shared by
+ * 				the descriptors of all the targets; drops and counters are still per target.
+ *
+ * RETURNS:
+ * number of targets the message was not dropped for
+ */
+int EmulNet::ENmulticast(Address *myaddr, Address *toaddrs, int count, char *data, int size) {
+	en_payload *payload = NULL;
+	char temp[2048];
+	int sent = 0;
+
+	if ( size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE ) {
 		return 0;
 	}
 
-	em = (en_msg *)malloc(sizeof(en_msg) + size);
-	em->size = size;
-
-	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
-	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
-	memcpy(em + 1, data, size);
-
-	emulnet.buff[emulnet.currbuffsize++] = em;
-
-	int src = *(int *)(myaddr->addr);
+	NodeId from = myaddr->getNodeId();
+	int src = from.getid();
 	int time = par->getcurrtime();
 
 	assert(src <= MAX_NODES);
 	assert(time < MAX_TIME);
 
-	sent_msgs[src][time]++;
+	for ( int i = 0; i < count; i++ ) {
+		int dst = toaddrs[i].getNodeId().getid();
+		int verdict, due = 0;
 
-	#ifdef DEBUGLOG
-		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
-	#endif
+		if ( trace != NULL && trace->replaying() ) {
+			TraceRecord rec = trace->expect(TR_SEND, time, src, dst, size);
+			verdict = rec.verdict;
+			due = rec.due;
+		}
+		else {
+			verdict = decide(src, dst, time, due);
+			if ( trace != NULL ) {
+				trace->write(time, TR_SEND, verdict, src, dst, size, due);
+			}
+		}
+		if ( verdict != TR_DELIVER ) {
+			countDrop(verdict, src, dst, time);
+			continue;
+		}
 
-	return size;
-}
+		// allocated for the first target that gets through
+		if ( payload == NULL ) {
+			payload = (en_payload *)malloc(sizeof(en_payload) + size);
+			payload->refs = 0;
+			payload->size = size;
+			memcpy(payload + 1, data, size);
+		}
 
-/**
- * FUNCTION NAME: ENsend
- *
- * DESCRIPTION: EmulNet send function
- *
- * RETURNS:
- * size
- */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+		en_msg em;
+		em.from = from;
+		em.to = toaddrs[i].getNodeId();
+		em.payload = payload;
+		em.due = due;
+		emulnet.push(em);
+		payload->refs++;
+
+		sent_msgs[src][time]++;
+		sent_bytes += size;
+		sent_count++;
+		sent++;
+
+		#ifdef DEBUGLOG
+			sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddrs[i].addr[0], toaddrs[i].addr[1], toaddrs[i].addr[2], toaddrs[i].addr[3], *(short *)&toaddrs[i].addr[4]);
+		#endif
+	}
+
+	return sent;
 }
 
 /**
  * FUNCTION NAME: ENrecv
  *
  * DESCRIPTION: EmulNet receive function
+ * 				Hands over the node's due messages in send order; only those are touched.
+ * 				Under RECV_RATE only as many as the node has receive tokens for are handed
+ * 				over, the rest stay queued for the next ticks.
+ * 				enq copies the payload; a false return means the node's inbox overflowed
  *
  * RETURN:
  * 0
  */
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
 	// times is always assumed to be 1
-	int i;
-	char* tmp;
-	int sz;
-	en_msg *emsg;
-
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
-
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
-
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
-
-			(*enq)(queue, (char *)tmp, sz);
-
-			free(emsg);
+	size_t i, n;
+	en_payload *payload;
+	int dst = myaddr->getNodeId().getid();
+	int time = par->getcurrtime();
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+	assert(dst <= MAX_NODES);
+	assert(time < MAX_TIME);
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+	emulnet.advance(time);
+	deque<en_msg> &ready = emulnet.readyFor(dst);
+	n = ready.size();
+	if ( trace != NULL && trace->replaying() ) {
+		n = trace->expect(TR_RECV, time, dst, 0, 0).size;
+		assert(n <= ready.size());
+	}
+	else if ( par->RECV_RATE > 0 ) {
+		en_node &node = nodeAt(dst, time);
+		n = min(n, (size_t)node.recvTokens);
+		node.recvTokens -= n;
+	}
+	if ( par->RECV_RATE > 0 ) {
+		en_node &node = nodeAt(dst, time);
+		node.queued += ready.size() - n;
+		node.maxQueue = max(node.maxQueue, (int)(ready.size() - n));
+	}
+	if ( trace != NULL && trace->recording() ) {
+		trace->write(time, TR_RECV, TR_DELIVER, dst, 0, n, 0);
+	}
+	for( i = 0; i < n; i++ ) {
+		payload = ready[i].payload;
 
-			recv_msgs[dst][time]++;
+		if ( !(*enq)(queue, (char *)(payload+1), payload->size) ) {
+			inbox_overflows++;
 		}
+
+		releasePayload(payload);
+		recv_msgs[dst][time]++;
 	}
+	emulnet.currbuffsize -= n;
+	ready.erase(ready.begin(), ready.begin() + n);
 
 	return 0;
 }
@@ -182,17 +622,17 @@ int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct ti
  * DESCRIPTION: Cleanup the EmulNet. Called exactly once at the end of the program.
  */
 int EmulNet::ENcleanup() {
+	// every id handed out, the nodes that churn or the timeline joined after the first EN_GPSZ included
+	int ids = min(emulnet.nextid - 1, MAX_NODES);
 	emulnet.nextid=0;
 	int i, j;
 	int sent_total, recv_total;
 
-	FILE* file = fopen("msgcount.log", "w+");
+	FILE* file = fopen(par->logfile(MSGCOUNT_LOG).c_str(), "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
-	}
+	emulnet.clear();
 
-	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
+	for ( i = 1; i <= ids; i++ ) {
 		fprintf(file, "node %3d ", i);
 		sent_total = 0;
 		recv_total = 0;
@@ -214,7 +654,37 @@ int EmulNet::ENcleanup() {
 		fprintf(file, "\n");
 		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
 	}
+	fprintf(file, "inbox overflow drops %d\n", inbox_overflows);
+	fprintf(file, "partition drops %d\n", partition_drops);
+	fprintf(file, "link loss drops %d\n", linkloss_drops);
+
+	// per node drops and receive queueing, only nodes with something to show
+	int loss = 0, buffer = 0, limit = 0, throttled = 0;
+	long long queued = 0;
+	en_node none;
+	memset(&none, 0, sizeof(none));
+	int n = max(nodes.size(), emulnet.inboxdrops.size());
+	for ( i = 1; i < n; i++ ) {
+		const en_node &node = i < (int)nodes.size() ? nodes[i] : none;
+		int inboxDrops = i < (int)emulnet.inboxdrops.size() ? emulnet.inboxdrops[i] : 0;
+		loss += node.lossDrops;
+		buffer += node.bufferDrops;
+		limit += inboxDrops;
+		throttled += node.throttleDrops;
+		queued += node.queued;
+		if ( node.lossDrops || node.bufferDrops || inboxDrops || node.throttleDrops || node.queued ) {
+			fprintf(file, "node %3d loss %5d buffer %5d inbox_limit %5d send_throttled %5d queued %6lld max_queue %4d\n",
+					i, node.lossDrops, node.bufferDrops, inboxDrops, node.throttleDrops, node.queued, node.maxQueue);
+		}
+	}
+	fprintf(file, "loss drops %d\n", loss);
+	fprintf(file, "buffer full drops %d\n", buffer);
+	fprintf(file, "inbox limit drops %d\n", limit);
+	fprintf(file, "send throttle drops %d\n", throttled);
+	fprintf(file, "recv throttle queued message-ticks %lld\n", queued);
 
 	fclose(file);
+
+	PROF_DUMP(par->logfile(PROFILE_LOG).c_str());
 	return 0;
 }
@@ -9,45 +9,134 @@
 
 #define MAX_NODES 1000
 #define MAX_TIME 3600
-#define ENBUFFSIZE 30000
+// ticks covered by the timing wheel, longer delays wait in the overflow heap
+#define DELAY_WHEEL_SLOTS 64
 
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "Transport.h"
+#include "Profiler.h"
+#include "Trace.h"
+#include <random>
+#include <unordered_map>
 
 using namespace std;
 
+/**
+ * Struct Name: en_payload
+ *
+ * Description: Message bytes shared by every en_msg of one send or multicast
+ */
+typedef struct en_payload {
+	// en_msg descriptors still pointing here
+	int refs;
+	// Number of bytes after the struct
+	int size;
+}en_payload;
+
 /**
  * Struct Name: en_msg
+ *
+ * Description: One in-flight delivery
  */
 typedef struct en_msg {
-	// Number of bytes after the class
-	int size;
 	// Source node
-	Address from;
+	NodeId from;
 	// Destination node
-	Address to;
+	NodeId to;
+	en_payload *payload;
+	// Tick from which the destination may receive it
+	int due;
 }en_msg;
 
+/**
+ * Struct Name: en_msg_later
+ *
+ * Description: Orders the overflow heap by delivery tick, earliest on top
+ */
+struct en_msg_later {
+	bool operator()(const en_msg &a, const en_msg &b) const {
+		return a.due > b.due;
+	}
+};
+
+/**
+ * FUNCTION NAME: releasePayload
+ *
+ * DESCRIPTION: Drop one reference, freeing the payload with the last one
+ */
+static inline void releasePayload(en_payload *payload) {
+	if ( --payload->refs == 0 ) {
+		free(payload);
+	}
+}
+
+/**
+ * Struct Name: en_node
+ *
+ * Description: Token buckets and drop counters of one node. Drops are charged to the
+ * 				destination, except send throttling which is charged to the sender.
+ */
+typedef struct en_node {
+	double sendTokens;
+	double recvTokens;
+	// tick the buckets were last refilled, -1 = never used
+	int refilled;
+	// MSG_DROP_PROB drops
+	int lossDrops;
+	// network buffer (EN_BUFFSIZE) full
+	int bufferDrops;
+	// sender out of send tokens
+	int throttleDrops;
+	// sum over the ticks of the messages left waiting for receive tokens, and the peak
+	long long queued;
+	int maxQueue;
+}en_node;
+
 /**
  * Class Name: EM
+ *
+ * Description: In-flight messages. Each descriptor owns a reference to its payload and sits in
+ * 				exactly one place: the timing wheel slot of its delivery tick, the overflow heap
+ * 				when that tick is more than DELAY_WHEEL_SLOTS ahead, or, once due, the ready
+ * 				queue of its destination. Advancing a tick only touches the messages due then.
+ * 				Ready queues are bounded by inboxlimit; a message due on a full one is dropped.
  */
 class EM {
 public:
 	int nextid;
 	int currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
-	EM() {}
-	EM& operator = (EM &anotherEM) {
-		this->nextid = anotherEM.getNextId();
-		this->currbuffsize = anotherEM.getCurrBuffSize();
-		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+	// last tick whose messages were moved to the ready queues
+	int wheeltick;
+	vector<vector<en_msg> > wheel;
+	priority_queue<en_msg, vector<en_msg>, en_msg_later> overflow;
+	// indexed by destination id
+	vector<deque<en_msg> > ready;
+	// most messages a ready queue holds, 0 = unbounded
+	int inboxlimit;
+	// messages dropped on a full ready queue, indexed by destination id
+	vector<int> inboxdrops;
+	EM(): nextid(0), currbuffsize(0), firsteltindex(0), wheeltick(-1), wheel(DELAY_WHEEL_SLOTS), inboxlimit(0) {}
+	EM(const EM &anotherEM) = delete;
+	EM& operator = (const EM &anotherEM) = delete;
+	EM(EM &&anotherEM): nextid(anotherEM.nextid), currbuffsize(anotherEM.currbuffsize), firsteltindex(anotherEM.firsteltindex),
+			wheeltick(anotherEM.wheeltick), wheel(std::move(anotherEM.wheel)), overflow(std::move(anotherEM.overflow)),
+			ready(std::move(anotherEM.ready)), inboxlimit(anotherEM.inboxlimit), inboxdrops(std::move(anotherEM.inboxdrops)) {
+		anotherEM.currbuffsize = 0;
+		anotherEM.wheel.assign(DELAY_WHEEL_SLOTS, vector<en_msg>());
+	}
+	EM& operator = (EM &&anotherEM) {
+		swap(nextid, anotherEM.nextid);
+		swap(currbuffsize, anotherEM.currbuffsize);
+		swap(firsteltindex, anotherEM.firsteltindex);
+		swap(wheeltick, anotherEM.wheeltick);
+		swap(wheel, anotherEM.wheel);
+		swap(overflow, anotherEM.overflow);
+		swap(ready, anotherEM.ready);
+		swap(inboxlimit, anotherEM.inboxlimit);
+		swap(inboxdrops, anotherEM.inboxdrops);
 		return *this;
 	}
 	int getNextId() {
@@ -68,7 +157,15 @@ public:
 	void setFirstEltIndex(int firsteltindex) {
 		this->firsteltindex = firsteltindex;
 	}
-	virtual ~EM() {}
+	void push(const en_msg &msg);
+	void advance(int tick);
+	void deliver(const en_msg &msg);
+	deque<en_msg> &readyFor(int id);
+	void clear();
+	void checkpoint(Checkpoint &ck);
+	virtual ~EM() {
+		clear();
+	}
 };
 
 /**
@@ -76,24 +173,60 @@ public:
  *
  * DESCRIPTION: This class defines an emulated network
  */
-class EmulNet
+class EmulNet : public Transport
 { 	
 private:
 	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	// [MAX_NODES + 1][MAX_TIME] counters on the heap, so moving an EmulNet is cheap
+	int (*sent_msgs)[MAX_TIME];
+	int (*recv_msgs)[MAX_TIME];
+	long long sent_bytes;
+	long long sent_count;
+	int inbox_overflows;
 	int enInited;
 	EM emulnet;
+	// draws of the delay model, seeded from SEED
+	mt19937 delayRng;
+	// message loss draws (MSG_DROP_PROB, link loss), owned so a checkpoint can carry them
+	mt19937 dropRng;
+	// partition label by node id, messages only pass between equal labels
+	vector<int> partition;
+	// (src << 32 | dst) -> loss probability of that link
+	unordered_map<uint64_t, double> linkLoss;
+	int partition_drops;
+	int linkloss_drops;
+	// token buckets and drop counters by node id
+	vector<en_node> nodes;
+	en_node &nodeAt(int id, int time);
+	// decisions are recorded to or replayed from here, NULL = neither
+	Trace *trace;
+	int delayOf(int src, int dst);
+	int faultDrops(int src, int dst);
+	int decide(int src, int dst, int time, int &due);
+	void countDrop(int verdict, int src, int dst, int time);
 public:
  	EmulNet(Params *p);
- 	EmulNet(EmulNet &anotherEmulNet);
- 	EmulNet& operator = (EmulNet &anotherEmulNet);
+ 	EmulNet(const EmulNet &anotherEmulNet) = delete;
+ 	EmulNet& operator = (const EmulNet &anotherEmulNet) = delete;
+ 	EmulNet(EmulNet &&anotherEmulNet);
+ 	EmulNet& operator = (EmulNet &&anotherEmulNet);
  	virtual ~EmulNet();
+	using Transport::ENsend;
 	void *ENinit(Address *myaddr, short port);
-	int ENsend(Address *myaddr, Address *toaddr, string data);
 	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
+	int ENmulticast(Address *myaddr, Address *toaddrs, int count, char *data, int size);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
 	int ENcleanup();
+	void setPartition(int id, int label);
+	void setLinkLoss(int src, int dst, double prob);
+	bool checkpoint(Checkpoint &ck);
+	bool setTrace(Trace *trace);
+	long long getSentBytes() {
+		return sent_bytes;
+	}
+	long long getSentMessages() {
+		return sent_count;
+	}
 };
 
 #endif /* _EMULNET_H_ */
@@ -0,0 +1,308 @@
+/**********************************
+ * FILE NAME: Inbox.h
+ *
+ * DESCRIPTION: Bounded lock-free message inboxes.
+ * 				SPSCInbox: single producer / single consumer (the emulator's delivery loop).
+ * 				MPSCInbox: many producers / single consumer (parallel or threaded senders).
+ **********************************/
+
+#ifndef _INBOX_H_
+#define _INBOX_H_
+
+#include "stdincludes.h"
+#include <atomic>
+
+/*
+ * Macros
+ */
+#define CACHE_LINE 64
+// slots per inbox, must be a power of two
+#define INBOX_CAPACITY 128
+// payload bytes stored inside the slot; bigger messages get a heap buffer
+#define INBOX_INLINE_SIZE 104
+
+/**
+ * STRUCT NAME: InboxSlot
+ *
+ * DESCRIPTION: One message in an inbox, exactly two cache lines
+ */
+typedef struct InboxSlot {
+	// sequence number, used by MPSCInbox only
+	atomic<size_t> seq;
+	int size;
+	char *heap;
+	char data[INBOX_INLINE_SIZE];
+	char *payload() {
+		return heap ? heap : data;
+	}
+}InboxSlot;
+
+static_assert(sizeof(InboxSlot) == 2 * CACHE_LINE, "InboxSlot must stay two cache lines");
+
+/**
+ * FUNCTION NAME: allocInboxSlots
+ *
+ * DESCRIPTION: Allocate cache-line aligned slots with seq[i] = i
+ */
+static inline InboxSlot *allocInboxSlots(size_t capacity) {
+	void *mem = NULL;
+	if ( posix_memalign(&mem, CACHE_LINE, capacity * sizeof(InboxSlot)) != 0 ) {
+		return NULL;
+	}
+	InboxSlot *slots = (InboxSlot *)mem;
+	for ( size_t i = 0; i < capacity; i++ ) {
+		new (&slots[i].seq) atomic<size_t>(i);
+		slots[i].size = 0;
+		slots[i].heap = NULL;
+	}
+	return slots;
+}
+
+/**
+ * FUNCTION NAME: fillInboxSlot
+ *
+ * DESCRIPTION: Copy a message into a slot, inline when it fits
+ */
+static inline void fillInboxSlot(InboxSlot *slot, const char *data, int size) {
+	slot->size = size;
+	if ( size <= INBOX_INLINE_SIZE ) {
+		slot->heap = NULL;
+		memcpy(slot->data, data, size);
+	}
+	else {
+		slot->heap = (char *) malloc(size);
+		memcpy(slot->heap, data, size);
+	}
+}
+
+/**
+ * CLASS NAME: SPSCInbox
+ *
+ * DESCRIPTION: Bounded ring for one producer and one consumer.
+ * 				head and tail live on their own cache lines, each side caches the other's index.
+ */
+class SPSCInbox {
+private:
+	InboxSlot *slots;
+	size_t mask;
+	char pad0[CACHE_LINE];
+	// producer side
+	atomic<size_t> tail;
+	size_t headCache;
+	unsigned long overflows;
+	char pad1[CACHE_LINE];
+	// consumer side
+	atomic<size_t> head;
+	size_t tailCache;
+	char pad2[CACHE_LINE];
+	SPSCInbox(const SPSCInbox &);
+	SPSCInbox& operator =(const SPSCInbox &);
+public:
+	SPSCInbox(size_t capacity = INBOX_CAPACITY): slots(allocInboxSlots(capacity)), mask(capacity - 1), tail(0), headCache(0), overflows(0), head(0), tailCache(0) {}
+	/**
+	 * Move constructor: takes over the slots and the queued messages.
+	 * Must not race with either side; the moved-from inbox is left without storage
+	 * and rejects every push.
+	 */
+	SPSCInbox(SPSCInbox &&another): slots(another.slots), mask(another.mask), tail(another.tail.load()), headCache(another.headCache),
+			overflows(another.overflows), head(another.head.load()), tailCache(another.tailCache) {
+		another.slots = NULL;
+		another.mask = 0;
+		another.tail.store(0);
+		another.head.store(0);
+		another.headCache = another.tailCache = 0;
+	}
+	SPSCInbox& operator =(SPSCInbox &&another) {
+		// our old messages are released by the temporary
+		SPSCInbox temp(std::move(another));
+		swap(slots, temp.slots);
+		swap(mask, temp.mask);
+		swap(headCache, temp.headCache);
+		swap(overflows, temp.overflows);
+		swap(tailCache, temp.tailCache);
+		size_t t = tail.load();
+		tail.store(temp.tail.load());
+		temp.tail.store(t);
+		size_t h = head.load();
+		head.store(temp.head.load());
+		temp.head.store(h);
+		return *this;
+	}
+	virtual ~SPSCInbox() {
+		while ( front() ) {
+			pop();
+		}
+		free(slots);
+	}
+	/**
+	 * Producer: copy the message in, false (and counted) if the inbox is full
+	 */
+	bool push(const char *data, int size) {
+		size_t t = tail.load(memory_order_relaxed);
+		if ( slots == NULL ) {
+			overflows++;
+			return false;
+		}
+		if ( t - headCache > mask ) {
+			headCache = head.load(memory_order_acquire);
+			if ( t - headCache > mask ) {
+				overflows++;
+				return false;
+			}
+		}
+		fillInboxSlot(&slots[t & mask], data, size);
+		tail.store(t + 1, memory_order_release);
+		return true;
+	}
+	/**
+	 * Consumer: oldest message or NULL, valid until pop()
+	 */
+	InboxSlot *front() {
+		size_t h = head.load(memory_order_relaxed);
+		if ( h == tailCache ) {
+			tailCache = tail.load(memory_order_acquire);
+			if ( h == tailCache ) {
+				return NULL;
+			}
+		}
+		return &slots[h & mask];
+	}
+	void pop() {
+		size_t h = head.load(memory_order_relaxed);
+		InboxSlot *slot = &slots[h & mask];
+		free(slot->heap);
+		slot->heap = NULL;
+		head.store(h + 1, memory_order_release);
+	}
+	bool empty() {
+		return head.load(memory_order_relaxed) == tail.load(memory_order_acquire);
+	}
+	unsigned long getOverflows() {
+		return overflows;
+	}
+};
+
+/**
+ * CLASS NAME: MPSCInbox
+ *
+ * DESCRIPTION: Bounded ring for many producers and one consumer.
+ * 				Each slot carries a sequence number: producers claim a position with a CAS on tail
+ * 				and publish by bumping the slot's seq, the consumer waits for seq == pos + 1.
+ */
+class MPSCInbox {
+private:
+	InboxSlot *slots;
+	size_t mask;
+	char pad0[CACHE_LINE];
+	// producer side
+	atomic<size_t> tail;
+	atomic<unsigned long> overflows;
+	char pad1[CACHE_LINE];
+	// consumer side
+	size_t head;
+	char pad2[CACHE_LINE];
+	MPSCInbox(const MPSCInbox &);
+	MPSCInbox& operator =(const MPSCInbox &);
+public:
+	MPSCInbox(size_t capacity = INBOX_CAPACITY): slots(allocInboxSlots(capacity)), mask(capacity - 1), tail(0), overflows(0), head(0) {}
+	/**
+	 * Move constructor: takes over the slots and the queued messages.
+	 * Must not race with producers or the consumer; the moved-from inbox is left without storage
+	 * and rejects every push.
+	 */
+	MPSCInbox(MPSCInbox &&another): slots(another.slots), mask(another.mask), tail(another.tail.load()),
+			overflows(another.overflows.load()), head(another.head) {
+		another.slots = NULL;
+		another.mask = 0;
+		another.tail.store(0);
+		another.head = 0;
+	}
+	MPSCInbox& operator =(MPSCInbox &&another) {
+		// our old messages are released by the temporary
+		MPSCInbox temp(std::move(another));
+		swap(slots, temp.slots);
+		swap(mask, temp.mask);
+		swap(head, temp.head);
+		size_t t = tail.load();
+		tail.store(temp.tail.load());
+		temp.tail.store(t);
+		unsigned long o = overflows.load();
+		overflows.store(temp.overflows.load());
+		temp.overflows.store(o);
+		return *this;
+	}
+	virtual ~MPSCInbox() {
+		while ( front() ) {
+			pop();
+		}
+		free(slots);
+	}
+	/**
+	 * Producer: copy the message in, false (and counted) if the inbox is full
+	 */
+	bool push(const char *data, int size) {
+		size_t pos = tail.load(memory_order_relaxed);
+		InboxSlot *slot;
+		if ( slots == NULL ) {
+			overflows.fetch_add(1, memory_order_relaxed);
+			return false;
+		}
+		for ( ;; ) {
+			slot = &slots[pos & mask];
+			size_t seq = slot->seq.load(memory_order_acquire);
+			long dif = (long)seq - (long)pos;
+			if ( dif == 0 ) {
+				if ( tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed) ) {
+					break;
+				}
+			}
+			else if ( dif < 0 ) {
+				overflows.fetch_add(1, memory_order_relaxed);
+				return false;
+			}
+			else {
+				pos = tail.load(memory_order_relaxed);
+			}
+		}
+		fillInboxSlot(slot, data, size);
+		slot->seq.store(pos + 1, memory_order_release);
+		return true;
+	}
+	/**
+	 * Consumer: oldest published message or NULL, valid until pop()
+	 */
+	InboxSlot *front() {
+		if ( slots == NULL ) {
+			return NULL;
+		}
+		InboxSlot *slot = &slots[head & mask];
+		if ( slot->seq.load(memory_order_acquire) != head + 1 ) {
+			return NULL;
+		}
+		return slot;
+	}
+	void pop() {
+		InboxSlot *slot = &slots[head & mask];
+		free(slot->heap);
+		slot->heap = NULL;
+		slot->seq.store(head + mask + 1, memory_order_release);
+		head++;
+	}
+	bool empty() {
+		return front() == NULL;
+	}
+	unsigned long getOverflows() {
+		return overflows.load(memory_order_relaxed);
+	}
+};
+
+/*
+ * Inbox used by Member: "make MPSC_INBOX=1" for multi-sender runtimes
+ */
+#ifdef MPSC_INBOX
+typedef MPSCInbox Inbox;
+#else
+typedef SPSCInbox Inbox;
+#endif
+
+#endif /* _INBOX_H_ */
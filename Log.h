@@ -10,6 +10,8 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "Profiler.h"
+#include "Metrics.h"
 
 /*
  * Macros
@@ -28,15 +30,26 @@
 class Log{
 private:
 	Params *par;
+	Metrics *metrics;
 	bool firstTime;
+	// dbg.log and stats.log of this run, opened by the first LOG call
+	FILE *fp;
+	FILE *fp2;
+	bool opened;
+	int numwrites;
+	char buffer[30000];
+	char stdstring[30];
 public:
-	Log(Params *p);
-	Log(const Log &anotherLog);
-	Log& operator = (const Log &anotherLog);
+	Log(Params *p, Metrics *m = NULL);
+	// Not copyable: a Log owns its open files
+	Log(const Log &anotherLog) = delete;
+	Log& operator = (const Log &anotherLog) = delete;
 	virtual ~Log();
+	void reopen(Metrics *m);
 	void LOG(Address *, const char * str, ...);
 	void logNodeAdd(Address *, Address *);
 	void logNodeRemove(Address *, Address *);
+	void logNodeEvict(Address *, Address *);
 };
 
 #endif /* _LOG_H_ */
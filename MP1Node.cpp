@@ -16,15 +16,13 @@
  * You can add new members to the class if you think it
  * is necessary for your logic to work
  */
-MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Address *address) {
-	for( int i = 0; i < 6; i++ ) {
-		NULLADDR[i] = 0;
-	}
+MP1Node::MP1Node(Member member, Params *params, Transport *emul, Log *log, Address *address) {
 	this->memberNode = member;
 	this->emulNet = emul;
 	this->log = log;
 	this->par = params;
-	this->memberNode->addr = *address;
+	this->memberNode.addr() = *address;
+	this->ringDirty = true;
 }
 
 /**
@@ -39,11 +37,12 @@ MP1Node::~MP1Node() {}
  * 				This function is called by a node to receive messages currently waiting for it
  */
 int MP1Node::recvLoop() {
-    if ( memberNode->bFailed ) {
+    if ( memberNode.isFailed() ) {
     	return false;
     }
     else {
-    	return emulNet->ENrecv(&(memberNode->addr), enqueueWrapper, NULL, 1, &(memberNode->mp1q));
+    	PROF_SCOPE(PROF_RECVLOOP, getIdFromAddress(&memberNode.addr()));
+    	return emulNet->ENrecv(&memberNode.addr(), enqueueWrapper, NULL, 1, memberNode.mp1q());
     }
 }
 
@@ -54,7 +53,7 @@ int MP1Node::recvLoop() {
  */
 int MP1Node::enqueueWrapper(void *env, char *buff, int size) {
 	Queue q;
-	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
+	return q.enqueue((Inbox *)env, (void *)buff, size);
 }
 
 /**
@@ -71,7 +70,7 @@ void MP1Node::nodeStart(char *servaddrstr, short servport) {
     // Self booting routines
     if( initThisNode(&joinaddr) == -1 ) {
 #ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "init_thisnode failed. Exit.");
+        log->LOG(&memberNode.addr(), "init_thisnode failed. Exit.");
 #endif
         exit(1);
     }
@@ -79,7 +78,7 @@ void MP1Node::nodeStart(char *servaddrstr, short servport) {
     if( !introduceSelfToGroup(&joinaddr) ) {
         finishUpThisNode();
 #ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "Unable to join self to group. Exiting.");
+        log->LOG(&memberNode.addr(), "Unable to join self to group. Exiting.");
 #endif
         exit(1);
     }
@@ -96,17 +95,19 @@ int MP1Node::initThisNode(Address *joinaddr) {
 	/*
 	 * This function is partially implemented and may require changes
 	 */
-	int id = *(int*)(&memberNode->addr.addr);
-	int port = *(short*)(&memberNode->addr.addr[4]);
-
-	memberNode->bFailed = false;
-	memberNode->inited = true;
-	memberNode->inGroup = false;
+	memberNode.setFailed(false);
+	memberNode.setInited(true);
+	memberNode.setInGroup(false);
     // node is up!
-	memberNode->nnb = 0;
-	memberNode->heartbeat = 0;
-	memberNode->pingCounter = TFAIL;
-	memberNode->timeOutCounter = -1;
+	memberNode.nnb() = 0;
+	// 0 on the first start. A restart counts on from the heartbeat the node crashed with: peers still
+	// holding that one ignore anything lower, and would take the restarted node for dead.
+	// first probe round on the first tick in the group, no probe unanswered yet
+	memberNode.pingCounter() = 1;
+	memberNode.timeOutCounter() = 0;
+	memberNode.backlog() = 0;
+	memberNode.probesInFlight() = 0;
+	memberNode.lastSuspicion() = memberNode.heartbeat() - TREMOVE;
     initMemberListTable(memberNode);
 
     return 0;
@@ -120,33 +121,33 @@ int MP1Node::initThisNode(Address *joinaddr) {
 int MP1Node::introduceSelfToGroup(Address *joinaddr) {
 	GossipMessage *msg;
 #ifdef DEBUGLOG
-    static char s[1024];
+    char s[1024];
 #endif
 
-    if ( 0 == memcmp((char *)&(memberNode->addr.addr), (char *)&(joinaddr->addr), sizeof(memberNode->addr.addr))) {
+    if ( memberNode.addr().getNodeId() == joinaddr->getNodeId() ) {
         // I am the group booter (first process to join the group). Boot up the group
 #ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "Starting up group...");
+        log->LOG(&memberNode.addr(), "Starting up group...");
 #endif
-        memberNode->inGroup = true;
+        memberNode.setInGroup(true);
     }
     else {
         // create JOINREQ message: format of data is {struct Address myaddr}
         msg = (GossipMessage *) malloc(sizeof(GossipMessage) + 1);
         msg->header.msgType = JOINREQ;
-        msg->sender = memberNode->addr;
+        msg->sender = memberNode.addr();
         msg->number_of_entries = 1;
-        msg->entries[0].id = getIdFromAddress(&memberNode->addr);
-        msg->entries[0].port = getPortFromAddress(&memberNode->addr);
-        msg->entries[0].heartbeat = memberNode->heartbeat;
+        msg->entries[0].id = getIdFromAddress(&memberNode.addr());
+        msg->entries[0].port = getPortFromAddress(&memberNode.addr());
+        msg->entries[0].heartbeat = memberNode.heartbeat();
 
 #ifdef DEBUGLOG
         sprintf(s, "Trying to join...");
-        log->LOG(&memberNode->addr, s);
+        log->LOG(&memberNode.addr(), s);
 #endif
 
         // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, sizeof(GossipMessage));
+        emulNet->ENsend(&memberNode.addr(), joinaddr, (char *)msg, sizeof(GossipMessage));
 
         free(msg);
     }
@@ -161,10 +162,72 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
  * DESCRIPTION: Wind up this node and clean up state
  */
 int MP1Node::finishUpThisNode(){
-   /*
-    * Your code goes here
-    */
-   return 0;
+    // the node leaves the group: its subscribers see it go
+    if (memberNode.isInited() && !memberNode.isFailed())
+        notify(MEMBER_LEAVE, getIdFromAddress(&memberNode.addr()), getPortFromAddress(&memberNode.addr()), memberNode.heartbeat());
+    return 0;
+}
+
+/**
+ * FUNCTION NAME: subscribe
+ *
+ * DESCRIPTION: Call callback(env, event) on every change of this node's view: members that
+ * 				join it, become suspect, fail or leave it
+ *
+ * RETURNS:
+ * the subscription's id, for unsubscribe
+ */
+int MP1Node::subscribe(MemberEventCallback callback, void *env) {
+    return memberNode.watch()->subscribe(callback, env);
+}
+
+/**
+ * FUNCTION NAME: unsubscribe
+ *
+ * DESCRIPTION: Stop a callback subscription
+ */
+bool MP1Node::unsubscribe(int id) {
+    MemberEvents *events = memberNode.events();
+    bool found = events != NULL && events->unsubscribe(id);
+    memberNode.unwatch();
+    return found;
+}
+
+/**
+ * FUNCTION NAME: eventQueue
+ *
+ * DESCRIPTION: Lock-free queue of this node's view changes, for a consumer that polls
+ * 				(possibly from another thread)
+ */
+MemberEventQueue *MP1Node::eventQueue() {
+    return memberNode.watch()->openQueue();
+}
+
+/**
+ * FUNCTION NAME: closeEventQueue
+ *
+ * DESCRIPTION: Stop queueing this node's view changes
+ */
+void MP1Node::closeEventQueue() {
+    MemberEvents *events = memberNode.events();
+    if (events != NULL)
+        events->closeQueue();
+    memberNode.unwatch();
+}
+
+/**
+ * FUNCTION NAME: publish
+ *
+ * DESCRIPTION: Build the event and hand it to the subscribers
+ */
+void MP1Node::publish(MemberEvents *events, int type, int id, short port, long heartbeat) {
+    MemberEvent ev;
+    ev.type = type;
+    ev.time = par->getcurrtime();
+    ev.observer = memberNode.addr().getNodeId();
+    ev.member = NodeId(id, port);
+    ev.heartbeat = heartbeat;
+    events->publish(ev);
 }
 
 /**
@@ -174,7 +237,7 @@ int MP1Node::finishUpThisNode(){
  * 				Check your messages in queue and perform membership protocol duties
  */
 void MP1Node::nodeLoop() {
-    if (memberNode->bFailed) {
+    if (memberNode.isFailed()) {
     	return;
     }
 
@@ -182,7 +245,7 @@ void MP1Node::nodeLoop() {
     checkMessages();
 
     // Wait until you're in the group...
-    if( !memberNode->inGroup ) {
+    if( !memberNode.isInGroup() ) {
     	return;
     }
 
@@ -198,37 +261,49 @@ void MP1Node::nodeLoop() {
  * DESCRIPTION: Check messages in the queue and call the respective message handler
  */
 void MP1Node::checkMessages() {
-    void *ptr;
-    int size;
+    InboxSlot *slot;
+    PROF_SCOPE(PROF_CHECKMESSAGES, getIdFromAddress(&memberNode.addr()));
+
+    // Pop waiting messages from memberNode's mp1q, handling them in place
+    while ( (slot = memberNode.mp1q()->front()) != NULL ) {
+    	recvCallBack((void *)&memberNode, slot->payload(), slot->size);
+    	memberNode.mp1q()->pop();
+    }
 
-    // Pop waiting messages from memberNode's mp1q
-    while ( !memberNode->mp1q.empty() ) {
-    	ptr = memberNode->mp1q.front().elt;
-    	size = memberNode->mp1q.front().size;
-    	memberNode->mp1q.pop();
-    	recvCallBack((void *)memberNode, (char *)ptr, size);
+    // Answer this tick's joiners at once; the view they get already includes each other
+    if (!pendingJoinReps.empty()) {
+        sendMessage(JOINREP, pendingJoinReps.data(), pendingJoinReps.size());
+        pendingJoinReps.clear();
     }
+    if (!pulledDeltas.empty())
+        pushPulledDeltas();
     return;
 }
 
 int MP1Node::getMostRecentMember() {
     int pos = 1;
     long ts = 0;
-    for (int i=1; i<memberNode->memberList.size(); i++) {
-        if (memberNode->memberList.at(i).gettimestamp() > ts){
-            ts = memberNode->memberList.at(i).getheartbeat();
+    MemberList view = memberNode.memberList();
+    for (int i=1; i<view.size(); i++) {
+        if (view.timestamp(i) > ts){
+            ts = view.heartbeat(i);
             pos = i;
         }
     }
     return pos;
 }
 
-int MP1Node::getOldestMember() {
+int MP1Node::getOldestMember(bool local) {
     int pos = 1;
-    long ts = memberNode->heartbeat;
-    for (int i=1; i<memberNode->memberList.size(); i++) {
-        if (memberNode->memberList.at(i).gettimestamp() < ts){
-            ts = memberNode->memberList.at(i).getheartbeat();
+    long ts = memberNode.heartbeat();
+    MemberList view = memberNode.memberList();
+    while (pos < view.size() - 1 && sameZone(view.id(pos)) != local)
+        pos++;
+    for (int i=pos; i<view.size(); i++) {
+        if (sameZone(view.id(i)) != local)  // evict from the same tier
+            continue;
+        if (view.timestamp(i) < ts){
+            ts = view.heartbeat(i);
             pos = i;
         }
     }
@@ -237,55 +312,87 @@ int MP1Node::getOldestMember() {
 
 void MP1Node::updateMemberList (int id, short port,	long heartbeat) {
 
-    if (id == getIdFromAddress(&memberNode->addr))  // It's me, just return my entry
+    if (id == getIdFromAddress(&memberNode.addr()))  // It's me, just return my entry
         return;
 
-    MemberListEntry *found = NULL;
-    for (vector<MemberListEntry>::iterator it = memberNode->memberList.begin(); found==NULL && it != memberNode->memberList.end(); ++it) {
-        if (id == it->getid() && port == it->getport())
-            found = &(*it);
-    }
-    if (found == NULL) {
+    MemberList view = memberNode.memberList();
+    int found = view.find(id, port);
+    bool local = sameZone(id);
+    if (found < 0) {
         // Member not found in List, add
         Address addedadr = createAddressFromIdPort(id, port);
-        log->logNodeAdd(&memberNode->addr, &addedadr);
-        if (GOSSIP_PAYLOAD_SIZE > memberNode->memberList.size()) {
+        log->logNodeAdd(&memberNode.addr(), &addedadr);
+        notify(MEMBER_JOIN, id, port, heartbeat);
+        ringDirty = true;
+        if (hasRoom(local)) {
+            // news for the adaptive scheduler; a full view trading members is not
+            addBacklog(1);
             MemberListEntry *newmember = (MemberListEntry *) malloc(sizeof(MemberListEntry) + 1);
             newmember->setid(id);
             newmember->setport(port);
             newmember->setheartbeat(heartbeat);
-            newmember->settimestamp(memberNode->heartbeat);
-            memberNode->memberList.push_back(*newmember); 
+            newmember->settimestamp(memberNode.heartbeat());
+            view.push_back(*newmember); 
             free(newmember);
         } else {
             // List full, replace one
-            //long pos = random(1, GOSSIP_PAYLOAD_SIZE-1);  // Random
-            long pos = getOldestMember();
-            Address addrtoberemoved = createAddressFromIdPort(memberNode->memberList.at(pos).getid(), memberNode->memberList.at(pos).getport());
-            log->logNodeRemove(&memberNode->addr, &addrtoberemoved);
-            memberNode->memberList.at(pos).setid(id);
-            memberNode->memberList.at(pos).setport(port);
-            memberNode->memberList.at(pos).setheartbeat(heartbeat);
-            memberNode->memberList.at(pos).settimestamp(memberNode->heartbeat);
+            long pos = getOldestMember(local);
+            Address addrtoberemoved = createAddressFromIdPort(view.id(pos), view.port(pos));
+            log->logNodeEvict(&memberNode.addr(), &addrtoberemoved);
+            notify(MEMBER_LEAVE, view.id(pos), view.port(pos), view.heartbeat(pos));
+            view.set(pos, MemberListEntry(id, port, heartbeat, memberNode.heartbeat()));
         }
     } else {
-        if (found->getheartbeat() < heartbeat) {
-            found->setheartbeat(heartbeat);
-            found->settimestamp(memberNode->heartbeat);
+        if (view.heartbeat(found) < heartbeat) {
+            view.touch(found, heartbeat, memberNode.heartbeat());
         }
     }
     return;
 }
 
+/**
+ * FUNCTION NAME: hasRoom
+ *
+ * DESCRIPTION: Can the view take one more member without evicting one. Zoned, each tier has its
+ * 				own bound: the zone's size for members of this node's zone, ZONE_LINKS for the others.
+ */
+bool MP1Node::hasRoom(bool local) {
+    MemberList view = memberNode.memberList();
+    if (!par->zoned())
+        return !view.full();
+
+    int members = 0;
+    for (int i = 1; i < view.size(); i++) {
+        if (sameZone(view.id(i)) == local)
+            members++;
+    }
+    return members < (local ? par->zoneCapacity() - 1 : par->ZONE_LINKS);
+}
+
 short MP1Node::loadGossipEntries (GossipMembershipEntry entries[]) {
     int pos = 0;
+    MemberList view = memberNode.memberList();
+    const uint64_t *failed = view.staleMask(memberNode.heartbeat() - TFAIL);
 
     memset(entries, 0, sizeof(GossipMessage::entries));
-    for (vector<MemberListEntry>::iterator it = memberNode->memberList.begin(); it != memberNode->memberList.end(); ++it) {
-        if (it->gettimestamp() >= memberNode->heartbeat - TFAIL) {  // do not propagate failed nodes
-            entries[pos].id = it->getid();
-            entries[pos].port = it->getport();
-            entries[pos++].heartbeat = it->getheartbeat();
+    if (par->wideViews()) {
+        // the view outgrows a message: this node, then a random sample of the rest
+        int n = view.sampleFresh(GOSSIP_PAYLOAD_SIZE - 1, memberNode.heartbeat() - TFAIL);
+        entries[pos].id = view.id(0);
+        entries[pos].port = view.port(0);
+        entries[pos++].heartbeat = view.heartbeat(0);
+        for (int i = 0; i < n; i++) {
+            entries[pos].id = view.id(view.sampled(i));
+            entries[pos].port = view.port(view.sampled(i));
+            entries[pos++].heartbeat = view.heartbeat(view.sampled(i));
+        }
+        return (pos);
+    }
+    for (int i = 0; i < view.size(); i++) {
+        if (!maskTest(failed, i)) {  // do not propagate failed nodes
+            entries[pos].id = view.id(i);
+            entries[pos].port = view.port(i);
+            entries[pos++].heartbeat = view.heartbeat(i);
         }
     }
     return (pos);
@@ -298,11 +405,175 @@ void MP1Node::processGossipMessage (GossipMessage *msg) {
     }
 }
 
+/**
+ * FUNCTION NAME: viewDigest
+ *
+ * DESCRIPTION: Push-pull: for every bucket, an order independent hash of the (id, heartbeat) pairs
+ * 				this node gossips in it. This node and peer are left out; their heartbeats travel in
+ * 				the message headers.
+ */
+void MP1Node::viewDigest(unsigned int digest[], Address *peer) {
+    MemberList view = memberNode.memberList();
+    const uint64_t *failed = view.staleMask(memberNode.heartbeat() - TFAIL);
+    NodeId other = peer->getNodeId();
+
+    memset(digest, 0, DIGEST_BUCKETS * sizeof(unsigned int));
+    for (int i = 1; i < view.size(); i++) {
+        NodeId member(view.id(i), view.port(i));
+        if (maskTest(failed, i) || member == other)
+            continue;
+        uint64_t h = member.hash() ^ ((uint64_t)view.heartbeat(i) * 0x9e3779b97f4a7c15ULL);
+        digest[member.hash() & (DIGEST_BUCKETS - 1)] += (unsigned int)(h ^ (h >> 32));
+    }
+}
+
+static bool deltaEntryLess(const GossipMembershipEntry &a, const GossipMembershipEntry &b) {
+    return a.id < b.id || (a.id == b.id && a.port < b.port);
+}
+
+/**
+ * FUNCTION NAME: loadDeltaEntries
+ *
+ * DESCRIPTION: Push-pull: all the entries viewDigest covers in the differing buckets. With known,
+ * 				the peer's own entries of those buckets sorted by deltaEntryLess, only what the peer
+ * 				lacks or has older.
+ */
+void MP1Node::loadDeltaEntries(vector<GossipMembershipEntry> &entries, unsigned short differing, Address *peer, vector<GossipMembershipEntry> *known) {
+    MemberList view = memberNode.memberList();
+    const uint64_t *failed = view.staleMask(memberNode.heartbeat() - TFAIL);
+    NodeId other = peer->getNodeId();
+
+    for (int i = 1; i < view.size(); i++) {
+        NodeId member(view.id(i), view.port(i));
+        if (maskTest(failed, i) || member == other || !((differing >> (member.hash() & (DIGEST_BUCKETS - 1))) & 1))
+            continue;
+        GossipMembershipEntry entry;
+        entry.id = view.id(i);
+        entry.port = view.port(i);
+        entry.heartbeat = view.heartbeat(i);
+        if (known != NULL) {
+            vector<GossipMembershipEntry>::iterator k = lower_bound(known->begin(), known->end(), entry, deltaEntryLess);
+            if (k != known->end() && k->id == entry.id && k->port == entry.port && k->heartbeat >= entry.heartbeat)
+                continue;
+        }
+        entries.push_back(entry);
+    }
+}
+
+/**
+ * FUNCTION NAME: sendDigest
+ *
+ * DESCRIPTION: Push-pull: open an exchange with a DIGESTREQ
+ */
+void MP1Node::sendDigest(int id, short port) {
+    DigestMessage msg;
+    Address destination = createAddressFromIdPort(id, port);
+
+    memset(&msg, 0, sizeof(DigestMessage));
+    msg.header.msgType = DIGESTREQ;
+    msg.sender = memberNode.addr();
+    msg.heartbeat = memberNode.heartbeat();
+    viewDigest(msg.digest, &destination);
+    emulNet->ENsend(&memberNode.addr(), &destination, (char *)&msg, sizeof(DigestMessage));
+}
+
+/**
+ * FUNCTION NAME: sendDelta
+ *
+ * DESCRIPTION: Push-pull: send the differing buckets and this node's entries in them (see
+ * 				loadDeltaEntries), GOSSIP_PAYLOAD_SIZE entries a part and without the unused entry slots
+ */
+void MP1Node::sendDelta(MsgTypes msgtype, Address *destination, unsigned short differing, vector<GossipMembershipEntry> *known) {
+    DeltaMessage msg;
+    vector<GossipMembershipEntry> entries;
+
+    if (differing)
+        loadDeltaEntries(entries, differing, destination, known);
+    // the peer already has the heartbeat of this node from its DIGESTREQ
+    if (msgtype == DIGESTPUSH && entries.empty())
+        return;
+    memset(&msg, 0, sizeof(DeltaMessage));
+    msg.header.msgType = msgtype;
+    msg.sender = memberNode.addr();
+    msg.heartbeat = memberNode.heartbeat();
+    msg.differing = differing;
+    size_t pos = 0;
+    do {
+        msg.number_of_entries = min(entries.size() - pos, (size_t)GOSSIP_PAYLOAD_SIZE);
+        msg.truncated = pos + msg.number_of_entries < entries.size();
+        copy(entries.begin() + pos, entries.begin() + pos + msg.number_of_entries, msg.entries);
+        emulNet->ENsend(&memberNode.addr(), destination, (char *)&msg,
+                offsetof(DeltaMessage, entries) + msg.number_of_entries * sizeof(GossipMembershipEntry));
+        pos += msg.number_of_entries;
+        msg.part++;
+    } while (msg.truncated);
+}
+
+/**
+ * FUNCTION NAME: processDigestMessage
+ *
+ * DESCRIPTION: Push-pull: compare a DIGESTREQ with this node's view and answer with the
+ * 				differing buckets (none when the views agree)
+ */
+void MP1Node::processDigestMessage(DigestMessage *msg) {
+    unsigned int digest[DIGEST_BUCKETS];
+    unsigned short differing = 0;
+
+    updateMemberList(getIdFromAddress(&msg->sender), getPortFromAddress(&msg->sender), msg->heartbeat);
+    viewDigest(digest, &msg->sender);
+    for (int b = 0; b < DIGEST_BUCKETS; b++) {
+        if (digest[b] != msg->digest[b])
+            differing |= 1 << b;
+    }
+    sendDelta(DIGESTREP, &msg->sender, differing, NULL);
+}
+
+/**
+ * FUNCTION NAME: processDeltaMessage
+ *
+ * DESCRIPTION: Push-pull: merge a DIGESTREP or DIGESTPUSH, the sender last so it is kept
+ */
+void MP1Node::processDeltaMessage(DeltaMessage *msg) {
+    for (int i = msg->number_of_entries - 1; i >= 0; i--) {
+        GossipMembershipEntry *entry = &msg->entries[i];
+        updateMemberList(entry->id, entry->port, entry->heartbeat);
+    }
+    updateMemberList(getIdFromAddress(&msg->sender), getPortFromAddress(&msg->sender), msg->heartbeat);
+}
+
+/**
+ * FUNCTION NAME: pushPulledDeltas
+ *
+ * DESCRIPTION: Push-pull: answer this pass's DIGESTREPs, all parts of a peer's reply at once, with
+ * 				the entries of ours that the peer lacks or holds older. They are already merged, so
+ * 				whatever the peer was newer on compares equal and stays home.
+ */
+void MP1Node::pushPulledDeltas() {
+    size_t first = 0;
+
+    while (first < pulledDeltas.size()) {
+        Address sender = pulledDeltas[first].sender;
+        unsigned short differing = 0;
+        vector<GossipMembershipEntry> known;
+        for (size_t i = first; i < pulledDeltas.size(); i++) {
+            DeltaMessage *delta = &pulledDeltas[i];
+            if (delta->sender.getNodeId() != sender.getNodeId())
+                continue;
+            differing |= delta->differing;
+            known.insert(known.end(), delta->entries, delta->entries + delta->number_of_entries);
+            // done with this one: later rounds look past it
+            delta->differing = 0;
+        }
+        sort(known.begin(), known.end(), deltaEntryLess);
+        sendDelta(DIGESTPUSH, &sender, differing, &known);
+        while (first < pulledDeltas.size() && pulledDeltas[first].differing == 0)
+            first++;
+    }
+    pulledDeltas.clear();
+}
+
 Address MP1Node::createAddressFromIdPort(int id, short port) {
-    static char s[8];
-    sprintf(s, "%d:%d", id, port);
-    Address *addr = new Address(s);
-    return *addr;
+    return Address(NodeId(id, port));
 }
 
 void MP1Node::sendMessage (MsgTypes msgtype, int id, short port) {
@@ -311,23 +582,26 @@ void MP1Node::sendMessage (MsgTypes msgtype, int id, short port) {
 }
 
 void MP1Node::sendMessage (MsgTypes msgtype, Address *destination) { 
+    sendMessage(msgtype, destination, 1);
+}
+
+void MP1Node::sendMessage (MsgTypes msgtype, Address *destinations, int count) {
     GossipMessage* response;
     response = (GossipMessage *) malloc(sizeof(GossipMessage) + 1);
     MessageHdr* hdr = (MessageHdr *) &response->header;
     hdr->msgType = msgtype;
-    vector<MemberListEntry> memberlist = memberNode->memberList;
 
     response->number_of_entries = loadGossipEntries(response->entries);
-    response->sender = memberNode->addr;
+    response->sender = memberNode.addr();
     
 
     //size_t msgsize = sizeof(MessageHdr) + sizeof(Address) + sizeof(long) + 1;
     //msg = (MessageHdr *) malloc(msgsize * sizeof(char));
     
     // msg->msgType = JOINREP;
-    // memcpy((char *)(msg+1), &memberNode->addr.addr, sizeof(Address));
-    // memcpy((char *)(msg+1) + 1 + sizeof(Address), &memberNode->heartbeat, sizeof(long));
-    emulNet->ENsend(&memberNode->addr, destination, (char *)response, sizeof(GossipMessage));
+    // memcpy((char *)(msg+1), &memberNode.addr().addr, sizeof(Address));
+    // memcpy((char *)(msg+1) + 1 + sizeof(Address), &memberNode.heartbeat(), sizeof(long));
+    emulNet->ENmulticast(&memberNode.addr(), destinations, count, (char *)response, sizeof(GossipMessage));
     free(response);
 }
 
@@ -341,7 +615,7 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
 	 * Your code goes here
 	 */
 #ifdef DEBUGLOG
-    static char s[1024];
+    char s[1024];
 #endif
 
         GossipMessage* msg;
@@ -350,14 +624,16 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
         switch (hdr->msgType) {
             case JOINREQ: {
                 printf("JOINREQ\n");
-                sendMessage (JOINREP, &msg->sender); 
+                pendingJoinReps.push_back(msg->sender);
+                addBacklog(1);
                 processGossipMessage(msg); 
                 break;
             }
             case JOINREP: {
                 printf("JOINREP\n");
                 processGossipMessage(msg);
-                memberNode->inGroup = true;
+                addBacklog(TFAIL);  // announce this node for as long as the backlog holds news
+                memberNode.setInGroup(true);
                 break;
             }
             case PINGREQ: {
@@ -368,20 +644,46 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
             }
             case PINGREP: {
                 printf("PINGREP\n");
+                if (memberNode.timeOutCounter() > 0)  // a probe answered
+                    memberNode.timeOutCounter()--;
                 processGossipMessage(msg);
                 break;
             }
+            case DIGESTREQ: {
+                printf("DIGESTREQ\n");
+                processDigestMessage((DigestMessage *) data);
+                break;
+            }
+            case DIGESTREP: {
+                printf("DIGESTREP\n");
+                DeltaMessage *delta = (DeltaMessage *) data;
+                if (delta->part == 0 && memberNode.timeOutCounter() > 0)  // a probe answered
+                    memberNode.timeOutCounter()--;
+                // the parts of the reply together hold all of the peer's entries in the differing
+                // buckets: only ours that are missing there or newer go back, after the pass
+                if (delta->differing) {
+                    pulledDeltas.push_back(DeltaMessage());
+                    memcpy(&pulledDeltas.back(), delta, offsetof(DeltaMessage, entries) + delta->number_of_entries * sizeof(GossipMembershipEntry));
+                }
+                processDeltaMessage(delta);
+                break;
+            }
+            case DIGESTPUSH: {
+                printf("DIGESTPUSH\n");
+                processDeltaMessage((DeltaMessage *) data);
+                break;
+            }
             case DUMMYLASTMSGTYPE: {
                 break;
             }
         }
 #ifdef DEBUGLOG
         sprintf(s, "Received message...");
-        log->LOG(&memberNode->addr, s);
+        log->LOG(&memberNode.addr(), s);
         Address* sender = &msg->sender;
         printAddress(sender);
         printf("--> ");
-        printAddress(&memberNode->addr);
+        printAddress(&memberNode.addr());
         printf("\n");
         int i; for (i = 0; i < size; i++) { if (i > 0) printf(":"); printf("%02X", data[i]); } printf("\n");
         printf("------FIN recvCallBack-----\n");
@@ -402,16 +704,28 @@ void MP1Node::nodeLoopOps() {
 	/*
 	 * Your code goes here
 	 */
-    memberNode->heartbeat++;
-    memberNode->memberList.at(0).setheartbeat(memberNode->heartbeat);  // Update my heartbeat in member list
-    memberNode->memberList.at(0).settimestamp(memberNode->heartbeat);  // Update my timestamp also
+    PROF_SCOPE(PROF_NODELOOPOPS, getIdFromAddress(&memberNode.addr()));
+    memberNode.heartbeat()++;
+    memberNode.memberList().touch(0, memberNode.heartbeat(), memberNode.heartbeat());  // Update my heartbeat and timestamp in member list
     printNodes();
+    if (memberNode.events() != NULL || par->ADAPTIVE) {
+        // a suspicion is news, but only one per TREMOVE ticks: members of a zone view that keep going
+        // stale and coming back would otherwise hold the fan-out, and the traffic, up for good
+        if (notifySuspects() > 0 && memberNode.heartbeat() - memberNode.lastSuspicion() >= TREMOVE) {
+            memberNode.lastSuspicion() = memberNode.heartbeat();
+            addBacklog(1);
+        }
+    }
     cleanFailedNodes();
-    if (memberNode->memberList.size() > 1) 
-        sendPing();
+    if (memberNode.memberList().size() > 1) {
+        if (par->ADAPTIVE)
+            scheduleProbes();
+        else
+            sendPings(1);
+    }
     else {
         #ifdef DEBUGLOG
-        log->LOG(&memberNode->addr, "NODE WITH NO MEMBERS IN MEMBER LIST!");
+        log->LOG(&memberNode.addr(), "NODE WITH NO MEMBERS IN MEMBER LIST!");
         #endif
         Address joinaddress = getJoinAddress();
         introduceSelfToGroup(&joinaddress);
@@ -422,48 +736,284 @@ void MP1Node::nodeLoopOps() {
 
 void MP1Node::cleanFailedNodes() {
     Address addrtoberemoved;
-    vector<MemberListEntry>::iterator it = memberNode->memberList.begin();
-    while (it != memberNode->memberList.end()) {
-        if (memberNode->heartbeat - TREMOVE >= it->gettimestamp()) {
-            addrtoberemoved = createAddressFromIdPort(it->id, it->port);
-            log->logNodeRemove(&memberNode->addr, &addrtoberemoved);
-            it = memberNode->memberList.erase(it);
-        } else 
-            ++it;
+    MemberList view = memberNode.memberList();
+    // timestamp <= heartbeat - TREMOVE
+    const uint64_t *expired = view.staleMask(memberNode.heartbeat() - TREMOVE + 1);
+    int removed = 0;
+    for (int i = 0; i < view.size(); i++) {
+        if (maskTest(expired, i)) {
+            addrtoberemoved = createAddressFromIdPort(view.id(i), view.port(i));
+            log->logNodeRemove(&memberNode.addr(), &addrtoberemoved);
+            notify(MEMBER_FAIL, view.id(i), view.port(i), view.heartbeat(i));
+            removed++;
+        }
+    }
+    if (removed) {
+        view.removeMasked(expired);
+        addBacklog(removed);
+        ringDirty = true;
     }
 }
 
+/**
+ * FUNCTION NAME: notifySuspects
+ *
+ * DESCRIPTION: Publish the entries that have just gone TFAIL heartbeats without news
+ *
+ * RETURNS:
+ * how many there are
+ */
+int MP1Node::notifySuspects() {
+    MemberList view = memberNode.memberList();
+    int suspects = 0;
+    for (int i = 1; i < view.size(); i++) {
+        if (view.timestamp(i) == memberNode.heartbeat() - TFAIL) {
+            notify(MEMBER_SUSPECT, view.id(i), view.port(i), view.heartbeat(i));
+            suspects++;
+        }
+    }
+    return suspects;
+}
+
 void MP1Node::printNodes() {
 #ifdef DEBUGLOG
     Address addr;
-    static char s[200];
-    vector<MemberListEntry>::iterator it = memberNode->memberList.begin();
-    if (it->id != getIdFromAddress(&memberNode->addr)) 
+    char s[200];
+    MemberList view = memberNode.memberList();
+    // timestamp <= heartbeat - TFAIL
+    const uint64_t *failed = view.staleMask(memberNode.heartbeat() - TFAIL + 1);
+    if (view.id(0) != getIdFromAddress(&memberNode.addr())) 
         printf("PROBLEM\n");
-    while (it != memberNode->memberList.end()) {
-        addr = createAddressFromIdPort(it->id, it->port);
-        if (memberNode->heartbeat - TFAIL >= it->gettimestamp()) 
-            sprintf(s, "%d:%d failed. (HB: %ld, TS: %ld)", it->id, it->port, it->getheartbeat(), it->gettimestamp());
+    for (int i = 0; i < view.size(); i++) {
+        addr = createAddressFromIdPort(view.id(i), view.port(i));
+        if (maskTest(failed, i)) 
+            sprintf(s, "%d:%d failed. (HB: %ld, TS: %ld)", view.id(i), view.port(i), view.heartbeat(i), view.timestamp(i));
         else
-            sprintf(s, "%d:%d alive. (HB: %ld, TS: %ld)", it->id, it->port, it->getheartbeat(), it->gettimestamp());
-        log->LOG(&memberNode->addr, s);
-        ++it;
+            sprintf(s, "%d:%d alive. (HB: %ld, TS: %ld)", view.id(i), view.port(i), view.heartbeat(i), view.timestamp(i));
+        log->LOG(&memberNode.addr(), s);
     }
 #endif
 }
 
-void MP1Node::sendPing() {
-    int offset = 0;
-    int size = memberNode->memberList.size();
-    int pos = (memberNode->heartbeat + offset) % (size-1) + 1;  // round robin pinging. Entry 0 is always me   // Random pinging //random((u_long)1, memberNode->memberList.size() - 1);  
-    while (offset < size  && memberNode->memberList.at(pos).gettimestamp() < memberNode->heartbeat - TFAIL)  // We selected a failed node AND haven't exceeded retries
-        pos = (memberNode->heartbeat + ++offset) % (size-1) + 1;
-    if (memberNode->memberList.at(pos).gettimestamp() > memberNode->heartbeat - TFAIL)  // Ping only not failed nodes
-        sendPing(memberNode->memberList.at(pos).getid(), memberNode->memberList.at(pos).getport());
+/**
+ * FUNCTION NAME: scheduleProbes
+ *
+ * DESCRIPTION: Adaptive protocol period (ADAPTIVE: 1). pingCounter counts the ticks down to the
+ * 				next probe round, timeOutCounter the probes still unanswered and backlog the view
+ * 				changes not yet spread. A round resends the probes lost (unanswered after a round
+ * 				trip) and sends one probe per unit of backlog, at least one and at most about log N.
+ * 				The next round comes after a tick while there is backlog or loss, else after
+ * 				PROBE_MAX_INTERVAL ticks.
+ */
+void MP1Node::scheduleProbes() {
+    if (--memberNode.pingCounter() > 0)
+        return;
+
+    // a reply takes two ticks: the probes of a round a tick ago are not lost yet
+    int lost = max(0, memberNode.timeOutCounter() - memberNode.probesInFlight());
+    memberNode.timeOutCounter() -= lost;
+    memberNode.backlog() += lost;
+    int fanout = max(1, min(memberNode.backlog(), spreadFactor()));
+    memberNode.backlog() = max(0, memberNode.backlog() - fanout);
+    int probes = memberNode.timeOutCounter();
+    sendPings(fanout);
+    memberNode.pingCounter() = (memberNode.backlog() > 0 || lost > 0) ? 1 : PROBE_MAX_INTERVAL;
+    memberNode.probesInFlight() = memberNode.pingCounter() == 1 ? memberNode.timeOutCounter() - probes : 0;
+}
+
+/**
+ * FUNCTION NAME: spreadFactor
+ *
+ * DESCRIPTION: Adaptive scheduler: ceil(log2(view size)), between 1 and PROBE_MAX_FANOUT
+ */
+int MP1Node::spreadFactor() {
+    int members = memberNode.memberList().size();
+    int spread = 1;
+    while (spread < PROBE_MAX_FANOUT && (1 << spread) < members)
+        spread++;
+    return spread;
+}
+
+/**
+ * FUNCTION NAME: sendPings
+ *
+ * DESCRIPTION: Probe fanout members of this node's zone (of the cluster when flat); zoned, the
+ * 				zone's representative also probes another zone
+ */
+void MP1Node::sendPings(int fanout) {
+    NodeId targets[PROBE_MAX_FANOUT];
+    int n = localTargets(min(fanout, PROBE_MAX_FANOUT), targets);
+    for (int i = 0; i < n; i++)
+        sendPing(targets[i].getid(), targets[i].getport());
+    // zoned: only the zone's representative of the moment crosses zones
+    if (par->zoned() && isRepresentative() && sampleZone(false, 1, targets) == 1)
+        sendPing(targets[0].getid(), targets[0].getport());
+}
+
+/**
+ * FUNCTION NAME: localTargets
+ *
+ * DESCRIPTION: Up to k distinct ping targets in this node's zone (the whole cluster when flat):
+ * 				from the ring overlay, else random members believed alive
+ *
+ * RETURNS:
+ * how many were written to out
+ */
+int MP1Node::localTargets(int k, NodeId *out) {
+    if (par->OVERLAY == OVERLAY_RING)
+        return ringTargets(k, out);
+    if (par->zoned())
+        return sampleZone(true, k, out);
+    return sampleAlive(k, out);  // Ping only not failed nodes, chosen at random
+}
+
+/**
+ * FUNCTION NAME: buildRing
+ *
+ * DESCRIPTION: Ring overlay: sort the view's members of this node's zone by ring position, this
+ * 				node included. Done again only after the view's membership changed.
+ */
+void MP1Node::buildRing() {
+    MemberList view = memberNode.memberList();
+    ring.clear();
+    for (int i = 0; i < view.size(); i++) {
+        if (sameZone(view.id(i))) {
+            NodeId member(view.id(i), view.port(i));
+            ring.push_back(make_pair(ringPosition(member), member));
+        }
+    }
+    sort(ring.begin(), ring.end());
+    ringDirty = false;
+}
+
+/**
+ * FUNCTION NAME: ringWalk
+ *
+ * DESCRIPTION: Ring overlay: the nth (from 1) member believed alive, this node left out, going
+ * 				clockwise from ring position from. O(log N) to find the start.
+ *
+ * RETURNS:
+ * false if there are fewer than nth
+ */
+bool MP1Node::ringWalk(int from, int nth, NodeId *out) {
+    NodeId me = memberNode.addr().getNodeId();
+    size_t start = lower_bound(ring.begin(), ring.end(), make_pair(from % RING_SIZE, NodeId())) - ring.begin();
+
+    for (size_t k = 0; k < ring.size(); k++) {
+        const NodeId &member = ring[(start + k) % ring.size()].second;
+        if (member != me && isAlive(member) && --nth == 0) {
+            *out = member;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * FUNCTION NAME: ringTargets
+ *
+ * DESCRIPTION: Ring overlay: a node probes in turn, from one slot per tick, its RING_SUCCESSORS
+ * 				successors and the successors of its position + 2^k for k < RING_FINGERS; k targets
+ * 				take k slots. Every node is then probed by a few deterministic predecessors,
+ * 				whatever the cluster size.
+ *
+ * RETURNS:
+ * how many distinct targets were written to out
+ */
+int MP1Node::ringTargets(int k, NodeId *out) {
+    int me = ringPosition(memberNode.addr().getNodeId());
+    int n = 0;
+
+    if (ringDirty)
+        buildRing();
+    for (int j = 0; j < k && j < RING_SUCCESSORS + RING_FINGERS; j++) {
+        int slot = (memberNode.heartbeat() + j) % (RING_SUCCESSORS + RING_FINGERS);
+        NodeId target;
+        bool found = slot < RING_SUCCESSORS ? ringWalk(me + 1, slot + 1, &target) || ringWalk(me + 1, 1, &target)
+                : ringWalk(me + (1 << (slot - RING_SUCCESSORS)), 1, &target);
+        if (found && find(out, out + n, target) == out + n)
+            out[n++] = target;
+    }
+    return n;
+}
+
+/**
+ * FUNCTION NAME: isRepresentative
+ *
+ * DESCRIPTION: Zoned: does this node speak for its zone this tick. The zone members it believes
+ * 				alive take turns in id order, ZONE_ROTATE ticks each.
+ */
+bool MP1Node::isRepresentative() {
+    MemberList view = memberNode.memberList();
+    int me = getIdFromAddress(&memberNode.addr());
+    int members = 1, rank = 0;
+
+    for (int i = 1; i < view.size(); i++) {
+        if (view.timestamp(i) > memberNode.heartbeat() - TFAIL && sameZone(view.id(i))) {
+            members++;
+            if (view.id(i) < me)
+                rank++;
+        }
+    }
+    return rank == (par->getcurrtime() / par->ZONE_ROTATE) % members;
+}
+
+/**
+ * FUNCTION NAME: sampleZone
+ *
+ * DESCRIPTION: Zoned: up to k distinct random members believed alive, of this node's zone (local)
+ * 				or of others. O(view size).
+ *
+ * RETURNS:
+ * how many were written to out
+ */
+int MP1Node::sampleZone(bool local, int k, NodeId *out) {
+    MemberList view = memberNode.memberList();
+    int n = view.sampleFresh(view.size(), memberNode.heartbeat() - TFAIL);
+    int found = 0;
+    for (int i = 0; i < n && found < k; i++) {
+        int pos = view.sampled(i);
+        if (sameZone(view.id(pos)) == local)
+            out[found++] = NodeId(view.id(pos), view.port(pos));
+    }
+    return found;
 }
 
 void MP1Node::sendPing(int id, short port) {
-    sendMessage(PINGREQ, id, port);
+    memberNode.timeOutCounter()++;  // until answered
+    if (par->GOSSIP_MODE == GOSSIP_PUSHPULL)
+        sendDigest(id, port);
+    else
+        sendMessage(PINGREQ, id, port);
+}
+
+/**
+ * FUNCTION NAME: isAlive
+ *
+ * DESCRIPTION: Does this node believe id is alive: itself while it runs, or a member of its
+ * 				view heard of within TFAIL heartbeats. O(1).
+ */
+bool MP1Node::isAlive(NodeId id) {
+    if (id == memberNode.addr().getNodeId())
+        return !memberNode.isFailed();
+    return memberNode.memberList().isFresh(id.getid(), id.getport(), memberNode.heartbeat() - TFAIL);
+}
+
+/**
+ * FUNCTION NAME: sampleAlive
+ *
+ * DESCRIPTION: Up to k distinct random members this node believes alive, itself excluded,
+ * 				drawn with the node's own generator. O(k).
+ *
+ * RETURNS:
+ * how many were written to out
+ */
+int MP1Node::sampleAlive(int k, NodeId *out) {
+    MemberList view = memberNode.memberList();
+    int n = view.sampleFresh(k, memberNode.heartbeat() - TFAIL);
+    for (int i = 0; i < n; i++)
+        out[i] = NodeId(view.id(view.sampled(i)), view.port(view.sampled(i)));
+    return n;
 }
 
 /**
@@ -472,7 +1022,7 @@ void MP1Node::sendPing(int id, short port) {
  * DESCRIPTION: Function checks if the address is NULL
  */
 int MP1Node::isNullAddress(Address *addr) {
-	return (memcmp(addr->addr, NULLADDR, 6) == 0 ? 1 : 0);
+	return (addr->getNodeId().isNull() ? 1 : 0);
 }
 
 /**
@@ -481,13 +1031,13 @@ int MP1Node::isNullAddress(Address *addr) {
  * DESCRIPTION: Returns the Address of the coordinator
  */
 Address MP1Node::getJoinAddress() {
-    Address joinaddr;
-
-    //memset(&joinaddr, 0, sizeof(Address));
-    *(int *)(&joinaddr.addr) = 1;
-    *(short *)(&joinaddr.addr[4]) = 0;
-
-    return joinaddr;
+    // zoned: join through the zone's lowest id, which itself joins through the coordinator
+    if (par->zoned()) {
+        int introducer = par->zoneIntroducer(getIdFromAddress(&memberNode.addr()));
+        if (introducer != getIdFromAddress(&memberNode.addr()))
+            return Address(NodeId(introducer, 0));
+    }
+    return Address(NodeId(1, 0));
 }
 
 /**
@@ -495,17 +1045,18 @@ Address MP1Node::getJoinAddress() {
  *
  * DESCRIPTION: Initialize the membership list
  */
-void MP1Node::initMemberListTable(Member *memberNode) {
-	memberNode->memberList.clear();
+void MP1Node::initMemberListTable(Member memberNode) {
+	memberNode.memberList().clear();
+	ringDirty = true;
     MemberListEntry *myentry = (MemberListEntry *) malloc(sizeof(MemberListEntry) + 1);
 
-    //memcpy(&port, &memberNode->addr.addr[4], sizeof(short));
-    myentry->setid(getIdFromAddress(&memberNode->addr));
-    myentry->setport(getPortFromAddress(&memberNode->addr));
-    myentry->setheartbeat(memberNode->heartbeat);
-    memberNode->memberList.push_back(*myentry);
+    //memcpy(&port, &memberNode.addr().addr[4], sizeof(short));
+    myentry->setid(getIdFromAddress(&memberNode.addr()));
+    myentry->setport(getPortFromAddress(&memberNode.addr()));
+    myentry->setheartbeat(memberNode.heartbeat());
+    myentry->settimestamp(memberNode.heartbeat());
+    memberNode.memberList().push_back(*myentry);
     free(myentry);
-    memberNode->myPos = memberNode->memberList.begin();
 }
 
 /**
@@ -520,13 +1071,9 @@ void MP1Node::printAddress(Address *addr)
 }
 
 int MP1Node::getIdFromAddress(Address *addr) {
-    int ret;
-    memcpy(&ret, &addr->addr[0], sizeof(int));
-    return (ret);
+    return addr->getNodeId().getid();
 }
 
 short MP1Node::getPortFromAddress(Address *addr) {
-    short ret;
-    memcpy(&ret, &addr->addr[4], sizeof(short));
-    return (ret);
+    return addr->getNodeId().getport();
 }
\ No newline at end of file
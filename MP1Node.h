@@ -9,12 +9,13 @@
 #define _MP1NODE_H_
 
 #include "stdincludes.h"
-#include <random>
+#include <cstddef>
 #include "Log.h"
 #include "Params.h"
 #include "Member.h"
-#include "EmulNet.h"
+#include "Transport.h"
 #include "Queue.h"
+#include "Profiler.h"
 
 /**
  * Macros
@@ -22,6 +23,15 @@
 #define TREMOVE 20
 #define TFAIL 5
 #define GOSSIP_PAYLOAD_SIZE 5
+// buckets of a push-pull view digest, a power of two no larger than 16
+#define DIGEST_BUCKETS 8
+// ring overlay: successors in a node's probe cycle, then one finger per power of two below RING_SIZE
+#define RING_SUCCESSORS 2
+#define RING_FINGERS 9
+// adaptive scheduler: longest probe interval of a quiet view, kept well below TFAIL so quiet members
+// still hear of each other in time, and most probes per round
+#define PROBE_MAX_INTERVAL 2
+#define PROBE_MAX_FANOUT 8
 
 /*
  * Note: You can change/add any functions in MP1Node.{h,cpp}
@@ -35,17 +45,12 @@ enum MsgTypes{
     JOINREP,
 	PINGREQ,
 	PINGREP,
+	DIGESTREQ,
+	DIGESTREP,
+	DIGESTPUSH,
     DUMMYLASTMSGTYPE
 };
 
-template<typename T>
-T random(T range_from, T range_to) {
-    std::random_device                  rand_dev;
-    std::mt19937                        generator(rand_dev());
-    std::uniform_int_distribution<T>    distr(range_from, range_to);
-    return distr(generator);
-}
-
 /**
  * STRUCT NAME: MessageHdr
  *
@@ -68,33 +73,124 @@ typedef struct GossipMessage {
 	GossipMembershipEntry entries[GOSSIP_PAYLOAD_SIZE];
 }GossipMessage;
 
+/**
+ * STRUCT NAME: DigestMessage
+ *
+ * DESCRIPTION: Push-pull DIGESTREQ: a hash of the sender's view for every bucket of members
+ */
+typedef struct DigestMessage {
+	MessageHdr header;
+	Address sender;
+	long heartbeat;
+	unsigned int digest[DIGEST_BUCKETS];
+}DigestMessage;
+
+/**
+ * STRUCT NAME: DeltaMessage
+ *
+ * DESCRIPTION: Push-pull DIGESTREP and DIGESTPUSH: the buckets that differ and the sender's
+ * 				entries in them. Only the first number_of_entries entries go on the wire. When the
+ * 				entries do not fit in one message they are split into parts 0, 1, ...; every part
+ * 				but the last is flagged truncated.
+ */
+typedef struct DeltaMessage {
+	MessageHdr header;
+	Address sender;
+	long heartbeat;
+	unsigned short differing;
+	unsigned short part;
+	bool truncated;
+	short number_of_entries;
+	GossipMembershipEntry entries[GOSSIP_PAYLOAD_SIZE];
+}DeltaMessage;
+
 /**
  * CLASS NAME: MP1Node
  *
- * DESCRIPTION: Class implementing Membership protocol functionalities for failure detection
+ * DESCRIPTION: Class implementing Membership protocol functionalities for failure detection.
+ * 				Keeps nothing but one pass's pending JOINREPs and DIGESTREPs and the ring built from its view: the node
+ * 				state is read through a Member view.
  */
 class MP1Node {
 private:
-	EmulNet *emulNet;
+	Transport *emulNet;
 	Log *log;
 	Params *par;
-	Member *memberNode;
-	char NULLADDR[6];
+	// view on this node's row of the NodeStore
+	Member memberNode;
+	// JOINREQ senders of the current checkMessages pass, answered with one multicast JOINREP
+	vector<Address> pendingJoinReps;
+	// DIGESTREP parts of the current checkMessages pass, answered with DIGESTPUSH once all are merged
+	vector<DeltaMessage> pulledDeltas;
+	// ring overlay: (ring position, id) of the view's members of this node's zone, sorted
+	vector<pair<int, NodeId> > ring;
+	// the view's membership changed since ring was built
+	bool ringDirty;
 	void sendMessage (MsgTypes msgtype, int id, short port);
 	void sendMessage (MsgTypes msgtype, Address *destination);
+	void sendMessage (MsgTypes msgtype, Address *destinations, int count);
 	void processGossipMessage (GossipMessage *msg);
 	short loadGossipEntries(GossipMembershipEntry entries[]);
 	void updateMemberList (int id, short port,	long heartbeat);
+	void viewDigest(unsigned int digest[], Address *peer);
+	void loadDeltaEntries(vector<GossipMembershipEntry> &entries, unsigned short differing, Address *peer, vector<GossipMembershipEntry> *known);
+	void sendDigest(int id, short port);
+	void sendDelta(MsgTypes msgtype, Address *destination, unsigned short differing, vector<GossipMembershipEntry> *known);
+	void processDigestMessage(DigestMessage *msg);
+	void processDeltaMessage(DeltaMessage *msg);
+	void pushPulledDeltas();
 	void cleanFailedNodes();
-	void sendPing();
+	int notifySuspects();
+	/**
+	 * Publish a view change; a single test when nobody subscribed to this node
+	 */
+	void notify(int type, int id, short port, long heartbeat) {
+		MemberEvents *events = memberNode.events();
+		if ( events != NULL ) {
+			publish(events, type, id, port, heartbeat);
+		}
+	}
+	void publish(MemberEvents *events, int type, int id, short port, long heartbeat);
+	void scheduleProbes();
+	/**
+	 * Adaptive scheduler: news of a view change should reach about log N peers directly. News
+	 * older than TFAIL full rounds has spread by gossip anyway, so the backlog stops there.
+	 */
+	void addBacklog(int changes) {
+		if ( par->ADAPTIVE ) {
+			int spread = spreadFactor();
+			memberNode.backlog() = min(memberNode.backlog() + changes * spread, spread * TFAIL);
+		}
+	}
+	int spreadFactor();
+	void sendPings(int fanout);
 	void sendPing(int id, short port);
 	void printNodes();
 	int getMostRecentMember();
-	int getOldestMember();
+	int getOldestMember(bool local);
+	/**
+	 * Zoned: is id in this node's zone; always true in a flat cluster
+	 */
+	bool sameZone(int id) {
+		return !par->zoned() || par->zoneOf(id) == par->zoneOf(getIdFromAddress(&memberNode.addr()));
+	}
+	bool hasRoom(bool local);
+	bool isRepresentative();
+	int sampleZone(bool local, int k, NodeId *out);
+	int localTargets(int k, NodeId *out);
+	/**
+	 * Ring overlay: position of a node on the RING_SIZE ring
+	 */
+	static int ringPosition(NodeId id) {
+		return id.hash() % RING_SIZE;
+	}
+	void buildRing();
+	bool ringWalk(int from, int nth, NodeId *out);
+	int ringTargets(int k, NodeId *out);
 
 public:
-	MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
-	Member * getMemberNode() {
+	MP1Node(Member, Params *, Transport *, Log *, Address *);
+	Member getMemberNode() {
 		return memberNode;
 	}
 	int recvLoop();
@@ -103,13 +199,19 @@ public:
 	int initThisNode(Address *joinaddr);
 	int introduceSelfToGroup(Address *joinAddress);
 	int finishUpThisNode();
+	int subscribe(MemberEventCallback callback, void *env);
+	bool unsubscribe(int id);
+	MemberEventQueue *eventQueue();
+	void closeEventQueue();
+	bool isAlive(NodeId id);
+	int sampleAlive(int k, NodeId *out);
 	void nodeLoop();
 	void checkMessages();
 	bool recvCallBack(void *env, char *data, int size);
 	void nodeLoopOps();
 	int isNullAddress(Address *addr);
 	Address getJoinAddress();
-	void initMemberListTable(Member *memberNode);
+	void initMemberListTable(Member memberNode);
 	void printAddress(Address *addr);
 	int getIdFromAddress(Address *addr);
 	short getPortFromAddress(Address *addr);
@@ -6,11 +6,6 @@
 
 #include "Member.h"
 
-/**
- * Constructor
- */
-q_elt::q_elt(void *elt, int size): elt(elt), size(size) {}
-
 /**
  * Copy constructor
  */
@@ -33,7 +28,7 @@ Address& Address::operator =(const Address& anotherAddress) {
  * Return true/non-zero if they have the same ip address and port number 
  * Return false/zero if they are different 
  */
-bool Address::operator ==(const Address& anotherAddress) {
+bool Address::operator ==(const Address& anotherAddress) const {
 	return !memcmp(this->addr, anotherAddress.addr, sizeof(this->addr));
 }
 
@@ -47,28 +42,6 @@ MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timest
  */
 MemberListEntry::MemberListEntry(int id, short port): id(id), port(port) {}
 
-/**
- * Copy constructor
- */
-MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
-	this->heartbeat = anotherMLE.heartbeat;
-	this->id = anotherMLE.id;
-	this->port = anotherMLE.port;
-	this->timestamp = anotherMLE.timestamp;
-}
-
-/**
- * Assignment operator overloading
- */
-MemberListEntry& MemberListEntry::operator =(const MemberListEntry &anotherMLE) {
-	MemberListEntry temp(anotherMLE);
-	swap(heartbeat, temp.heartbeat);
-	swap(id, temp.id);
-	swap(port, temp.port);
-	swap(timestamp, temp.timestamp);
-	return *this;
-}
-
 /**
  * FUNCTION NAME: getid
  *
@@ -142,36 +115,378 @@ void MemberListEntry::settimestamp(long timestamp) {
 }
 
 /**
- * Copy Constructor
+ * FUNCTION NAME: set
+ *
+ * DESCRIPTION: Overwrite entry i, re-keying it in the index
  */
-Member::Member(const Member &anotherMember) {
-	this->addr = anotherMember.addr;
-	this->inited = anotherMember.inited;
-	this->inGroup = anotherMember.inGroup;
-	this->bFailed = anotherMember.bFailed;
-	this->nnb = anotherMember.nnb;
-	this->heartbeat = anotherMember.heartbeat;
-	this->pingCounter = anotherMember.pingCounter;
-	this->timeOutCounter = anotherMember.timeOutCounter;
-	this->memberList = anotherMember.memberList;
-	this->myPos = anotherMember.myPos;
-	this->mp1q = anotherMember.mp1q;
+void MemberList::set(size_t i, const MemberListEntry &entry) {
+	check();
+	indexRemove(i);
+	write(i, entry);
+	indexAdd(i);
+	addCandidate(i);
 }
 
 /**
- * Assignment operator overloading
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Position of the entry of id:port, one probe of the index in the common case
+ *
+ * RETURNS:
+ * -1 if it is not in the view
  */
-Member& Member::operator =(const Member& anotherMember) {
-	this->addr = anotherMember.addr;
-	this->inited = anotherMember.inited;
-	this->inGroup = anotherMember.inGroup;
-	this->bFailed = anotherMember.bFailed;
-	this->nnb = anotherMember.nnb;
-	this->heartbeat = anotherMember.heartbeat;
-	this->pingCounter = anotherMember.pingCounter;
-	this->timeOutCounter = anotherMember.timeOutCounter;
-	this->memberList = anotherMember.memberList;
-	this->myPos = anotherMember.myPos;
-	this->mp1q = anotherMember.mp1q;
-	return *this;
+int MemberList::find(int id, short port) {
+	check();
+	int h = NodeId(id, port).hash() & slotMask;
+	for ( ; slots[h] >= 0; h = (h + 1) & slotMask ) {
+		if ( ids[slots[h]] == id && ports[slots[h]] == port ) {
+			return slots[h];
+		}
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: indexAdd
+ *
+ * DESCRIPTION: Put position i in the hash table (linear probing)
+ */
+void MemberList::indexAdd(int i) {
+	int h = home(i);
+	while ( slots[h] >= 0 ) {
+		h = (h + 1) & slotMask;
+	}
+	slots[h] = i;
+}
+
+/**
+ * FUNCTION NAME: indexRemove
+ *
+ * DESCRIPTION: Take position i out of the hash table, shifting back the entries
+ * 				probed past it so no lookup chain is broken
+ */
+void MemberList::indexRemove(int i) {
+	int hole = home(i);
+	while ( slots[hole] != i ) {
+		hole = (hole + 1) & slotMask;
+	}
+	slots[hole] = -1;
+	for ( int j = (hole + 1) & slotMask; slots[j] >= 0; j = (j + 1) & slotMask ) {
+		int k = home(slots[j]);
+		// move slots[j] into the hole unless its home lies cyclically in (hole, j]
+		if ( (j > hole) ? (k <= hole || k > j) : (k <= hole && k > j) ) {
+			slots[hole] = slots[j];
+			slots[j] = -1;
+			hole = j;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: addCandidate
+ *
+ * DESCRIPTION: Make position i a sampling candidate again, if it is not one (never the node itself)
+ */
+void MemberList::addCandidate(int i) {
+	if ( i > 0 && alivePos[i] < 0 ) {
+		alivePos[i] = *aliveCount;
+		alive[(*aliveCount)++] = i;
+	}
+}
+
+/**
+ * FUNCTION NAME: swapCandidates
+ *
+ * DESCRIPTION: Exchange two places of the candidate list
+ */
+void MemberList::swapCandidates(int a, int b) {
+	swap(alive[a], alive[b]);
+	alivePos[alive[a]] = a;
+	alivePos[alive[b]] = b;
+}
+
+/**
+ * FUNCTION NAME: reindex
+ *
+ * DESCRIPTION: Rebuild the hash table and the candidates after entries moved
+ */
+void MemberList::reindex() {
+	memset(slots, -1, (slotMask + 1) * sizeof(*slots));
+	memset(alivePos, -1, capacity * sizeof(*alivePos));
+	*aliveCount = 0;
+	for ( int i = 0; i < *count; i++ ) {
+		indexAdd(i);
+		addCandidate(i);
+	}
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Remove entry i, keeping the order of the others
+ */
+void MemberList::erase(size_t i) {
+	check();
+	size_t tail = *count - i - 1;
+	memmove(ids + i, ids + i + 1, tail * sizeof(*ids));
+	memmove(ports + i, ports + i + 1, tail * sizeof(*ports));
+	memmove(heartbeats + i, heartbeats + i + 1, tail * sizeof(*heartbeats));
+	memmove(timestamps + i, timestamps + i + 1, tail * sizeof(*timestamps));
+	(*count)--;
+	reindex();
+}
+
+/**
+ * FUNCTION NAME: staleMask
+ *
+ * DESCRIPTION: Bitmask of the entries with timestamp < limit
+ */
+const uint64_t *MemberList::staleMask(long limit) {
+	check();
+	scanBelow(timestamps, *count, limit, scratch);
+	return scratch;
+}
+
+/**
+ * FUNCTION NAME: removeMasked
+ *
+ * DESCRIPTION: Compact the view down to the entries whose bit is clear, in order
+ */
+void MemberList::removeMasked(const uint64_t *mask) {
+	check();
+	int kept = 0;
+	for ( int k = 0; k < *count; k++ ) {
+		if ( maskTest(mask, k) ) {
+			continue;
+		}
+		if ( kept != k ) {
+			ids[kept] = ids[k];
+			ports[kept] = ports[k];
+			heartbeats[kept] = heartbeats[k];
+			timestamps[kept] = timestamps[k];
+		}
+		kept++;
+	}
+	*count = kept;
+	reindex();
+}
+
+/**
+ * FUNCTION NAME: isFresh
+ *
+ * DESCRIPTION: Is id:port another entry of the view with timestamp > cutoff. O(1).
+ */
+bool MemberList::isFresh(int id, short port, long cutoff) {
+	int i = find(id, port);
+	return i > 0 && timestamps[i] > cutoff;
+}
+
+/**
+ * FUNCTION NAME: sampleFresh
+ *
+ * DESCRIPTION: Draw up to k distinct random entries other than the node itself with timestamp
+ * 				> cutoff; sampled(0..n-1) are their positions. A partial Fisher-Yates shuffle
+ * 				of the candidates: stale ones met on the way leave the list, so the cost is
+ * 				O(k) amortized.
+ *
+ * RETURNS:
+ * how many were drawn
+ */
+int MemberList::sampleFresh(int k, long cutoff) {
+	check();
+	int n = 0;
+	while ( n < k && n < *aliveCount ) {
+		swapCandidates(n, n + random() % (*aliveCount - n));
+		int i = alive[n];
+		if ( timestamps[i] > cutoff ) {
+			n++;
+			continue;
+		}
+		swapCandidates(n, *aliveCount - 1);
+		alivePos[i] = -1;
+		(*aliveCount)--;
+	}
+	return n;
+}
+
+/**
+ * FUNCTION NAME: random
+ *
+ * DESCRIPTION: Next number of the node's xorshift64* generator
+ */
+uint64_t MemberList::random() {
+	check();
+	uint64_t x = *rng;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*rng = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+/**
+ * Constructor
+ * viewCapacity is the most entries a node's membership table can hold,
+ * seed starts the nodes' random generators
+ */
+NodeStore::NodeStore(int viewCapacity, uint64_t seed): viewCapacity(viewCapacity),
+		viewStride((viewCapacity + SCAN_LANES - 1) / SCAN_LANES * SCAN_LANES), scanMask(MASK_WORDS(viewCapacity)), seed(seed), generation(0) {
+	// at most half full
+	for ( slotSize = 1; slotSize < 2 * viewCapacity; slotSize *= 2 );
+}
+
+/**
+ * Destructor
+ */
+NodeStore::~NodeStore() {
+	for ( size_t i = 0; i < inboxes.size(); i++ ) {
+		delete inboxes[i];
+		delete watchers[i];
+	}
+}
+
+/**
+ * FUNCTION NAME: reserve
+ *
+ * DESCRIPTION: Make room for this many nodes up front
+ */
+void NodeStore::reserve(int nodes) {
+	addrs.reserve(nodes);
+	flags.reserve(nodes);
+	nnbs.reserve(nodes);
+	heartbeats.reserve(nodes);
+	pingCounters.reserve(nodes);
+	timeOutCounters.reserve(nodes);
+	backlogs.reserve(nodes);
+	probesInFlight.reserve(nodes);
+	lastSuspicions.reserve(nodes);
+	viewSizes.reserve(nodes);
+	viewIds.reserve((size_t)viewStride * nodes);
+	viewPorts.reserve((size_t)viewStride * nodes);
+	viewHeartbeats.reserve((size_t)viewStride * nodes);
+	viewTimestamps.reserve((size_t)viewStride * nodes);
+	viewSlots.reserve((size_t)slotSize * nodes);
+	aliveLists.reserve((size_t)viewStride * nodes);
+	aliveCounts.reserve(nodes);
+	alivePositions.reserve((size_t)viewStride * nodes);
+	rngStates.reserve(nodes);
+	inboxes.reserve(nodes);
+	watchers.reserve(nodes);
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Append a node that is not up yet, with an empty view
+ *
+ * RETURNS:
+ * its index
+ */
+int NodeStore::add() {
+	Address addr;
+	addr.init();
+	generation++;
+	addrs.push_back(addr);
+	flags.push_back(0);
+	nnbs.push_back(0);
+	heartbeats.push_back(0);
+	pingCounters.push_back(0);
+	timeOutCounters.push_back(0);
+	backlogs.push_back(0);
+	probesInFlight.push_back(0);
+	lastSuspicions.push_back(0);
+	viewSizes.push_back(0);
+	viewIds.resize(viewIds.size() + viewStride);
+	viewPorts.resize(viewPorts.size() + viewStride);
+	viewHeartbeats.resize(viewHeartbeats.size() + viewStride);
+	viewTimestamps.resize(viewTimestamps.size() + viewStride);
+	viewSlots.resize(viewSlots.size() + slotSize, -1);
+	aliveLists.resize(aliveLists.size() + viewStride);
+	aliveCounts.push_back(0);
+	alivePositions.resize(alivePositions.size() + viewStride, -1);
+	// odd, so never 0: the one state xorshift cannot leave
+	rngStates.push_back((NodeId(flags.size(), 0).hash() ^ seed) | 1);
+	inboxes.push_back(NULL);
+	watchers.push_back(NULL);
+	return flags.size() - 1;
+}
+
+/**
+ * FUNCTION NAME: inbox
+ *
+ * DESCRIPTION: The ith node's inbox, allocated on first use
+ */
+Inbox *NodeStore::inbox(int i) {
+	if ( inboxes[i] == NULL ) {
+		inboxes[i] = new Inbox();
+	}
+	return inboxes[i];
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load every node: the columns, the view columns and the messages still
+ * 				waiting in the inboxes. Loading needs a store of the saved size.
+ * 				Event subscriptions belong to the running program and are not saved.
+ *
+ * RETURNS:
+ * false if the views were saved with another capacity
+ */
+bool NodeStore::checkpoint(Checkpoint &ck) {
+	int capacity = viewCapacity;
+	uint64_t n;
+
+	ck.pod(capacity);
+	if ( capacity != viewCapacity ) {
+		return false;
+	}
+	if ( ck.loading() ) {
+		generation++;
+	}
+	for ( size_t i = 0; i < addrs.size(); i++ ) {
+		ck.bytes(addrs[i].addr, sizeof(addrs[i].addr));
+	}
+	ck.podVector(flags);
+	ck.podVector(nnbs);
+	ck.podVector(heartbeats);
+	ck.podVector(pingCounters);
+	ck.podVector(timeOutCounters);
+	ck.podVector(backlogs);
+	ck.podVector(probesInFlight);
+	ck.podVector(lastSuspicions);
+	ck.podVector(viewSizes);
+	ck.podVector(viewIds);
+	ck.podVector(viewPorts);
+	ck.podVector(viewHeartbeats);
+	ck.podVector(viewTimestamps);
+	ck.podVector(viewSlots);
+	ck.podVector(aliveLists);
+	ck.podVector(aliveCounts);
+	ck.podVector(alivePositions);
+	ck.podVector(rngStates);
+
+	// Drained into a list and pushed back, so saving leaves the inbox as it was
+	for ( size_t i = 0; i < inboxes.size() && ck.good(); i++ ) {
+		vector<vector<char> > queued;
+		InboxSlot *slot;
+		if ( inboxes[i] != NULL ) {
+			while ( (slot = inboxes[i]->front()) != NULL ) {
+				if ( !ck.loading() ) {
+					queued.push_back(vector<char>(slot->payload(), slot->payload() + slot->size));
+				}
+				inboxes[i]->pop();
+			}
+		}
+		n = queued.size();
+		ck.pod(n);
+		if ( ck.loading() ) {
+			queued.resize(ck.good() ? n : 0);
+		}
+		for ( size_t k = 0; k < queued.size(); k++ ) {
+			ck.podVector(queued[k]);
+			inbox(i)->push(queued[k].data(), queued[k].size());
+		}
+	}
+	return ck.good() && viewSizes.size() == flags.size();
 }
@@ -8,18 +8,11 @@
 #define MEMBER_H_
 
 #include "stdincludes.h"
-
-/**
- * CLASS NAME: q_elt
- *
- * DESCRIPTION: Entry in the queue
- */
-class q_elt {
-public:
-	void *elt;
-	int size;
-	q_elt(void *elt, int size);
-};
+#include "Inbox.h"
+#include "NodeId.h"
+#include "Checkpoint.h"
+#include "ViewScan.h"
+#include "MemberEvents.h"
 
 /**
  * CLASS NAME: Address
@@ -34,20 +27,30 @@ public:
 	Address(const Address &anotherAddress);
 	 // Overloaded = operator
 	Address& operator =(const Address &anotherAddress);
-	bool operator ==(const Address &anotherAddress);
+	bool operator ==(const Address &anotherAddress) const;
 	Address(string address) {
-		size_t pos = address.find(":");
-		int id = stoi(address.substr(0, pos));
-		short port = (short)stoi(address.substr(pos + 1, address.size()-pos-1));
+		NodeId nodeId;
+		if ( !NodeId::parse(address.c_str(), nodeId) ) {
+			nodeId = NodeId();
+		}
+		*this = Address(nodeId);
+	}
+	// Conversions to and from the packed NodeId
+	Address(const NodeId &nodeId) {
+		int id = nodeId.getid();
+		short port = nodeId.getport();
 		memcpy(&addr[0], &id, sizeof(int));
 		memcpy(&addr[4], &port, sizeof(short));
 	}
-	string getAddress() {
-		int id = 0;
+	NodeId getNodeId() const {
+		int id;
 		short port;
 		memcpy(&id, &addr[0], sizeof(int));
 		memcpy(&port, &addr[4], sizeof(short));
-		return to_string(id) + ":" + to_string(port);
+		return NodeId(id, port);
+	}
+	string getAddress() {
+		return getNodeId().toString();
 	}
 	void init() {
 		memset(&addr, 0, sizeof(addr));
@@ -57,7 +60,8 @@ public:
 /**
  * CLASS NAME: MemberListEntry
  *
- * DESCRIPTION: Entry in the membership list
+ * DESCRIPTION: Entry in the membership list. The views keep these fields column by
+ * 				column (see MemberList); an entry is how one row is passed around.
  */
 class MemberListEntry {
 public:
@@ -68,8 +72,8 @@ public:
 	MemberListEntry(int id, short port, long heartbeat, long timestamp);
 	MemberListEntry(int id, short port);
 	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0) {}
-	MemberListEntry(const MemberListEntry &anotherMLE);
-	MemberListEntry& operator =(const MemberListEntry &anotherMLE);
+	MemberListEntry(const MemberListEntry &anotherMLE) = default;
+	MemberListEntry& operator =(const MemberListEntry &anotherMLE) = default;
 	int getid();
 	short getport();
 	long getheartbeat();
@@ -80,45 +84,330 @@ public:
 	void settimestamp(long timestamp);
 };
 
+/**
+ * Bits of NodeStore::flags
+ */
+#define NODE_INITED 1
+#define NODE_INGROUP 2
+#define NODE_FAILED 4
+
+class NodeStore;
+
+/**
+ * CLASS NAME: MemberList
+ *
+ * DESCRIPTION: One node's membership table: a window of NodeStore's view columns (ids,
+ * 				ports, heartbeats, timestamps) with room for the store's view capacity.
+ * 				Entry 0 is the node itself. Valid until a node is added to the store: the
+ * 				columns may move then, and every call asserts the store has not grown since.
+ * 				staleMask scans the timestamps with the ViewScan kernel; the mask it returns
+ * 				is shared by the whole store and holds until the next scan.
+ *
+ * 				Every change goes through the list, which keeps an index up to date: a small
+ * 				open-addressing table from NodeId to position, and the candidate list of the
+ * 				other entries that may be fresh. Entries that went stale are only dropped from
+ * 				the candidates when a sample runs into them, and come back when touched.
+ */
+class MemberList {
+private:
+	NodeStore *store;
+	// NodeStore::generation when the pointers below were taken
+	unsigned int generation;
+	int *ids;
+	short *ports;
+	long *heartbeats;
+	long *timestamps;
+	int *count;
+	int capacity;
+	uint64_t *scratch;
+	// hash table of positions, -1 = empty; slotMask + 1 slots
+	int *slots;
+	int slotMask;
+	// candidates (positions > 0), and where each position sits among them (-1 = not a candidate)
+	int *alive;
+	int *aliveCount;
+	int *alivePos;
+	// xorshift64* state of the node
+	uint64_t *rng;
+	int home(int i) {
+		return NodeId(ids[i], ports[i]).hash() & slotMask;
+	}
+	void write(size_t i, const MemberListEntry &entry) {
+		ids[i] = entry.id;
+		ports[i] = entry.port;
+		heartbeats[i] = entry.heartbeat;
+		timestamps[i] = entry.timestamp;
+	}
+	void indexAdd(int i);
+	void indexRemove(int i);
+	void addCandidate(int i);
+	void swapCandidates(int a, int b);
+	void reindex();
+	void check();
+public:
+	MemberList(NodeStore *store, int node);
+	size_t size() {
+		check();
+		return *count;
+	}
+	bool empty() {
+		check();
+		return *count == 0;
+	}
+	bool full() {
+		check();
+		return *count >= capacity;
+	}
+	int id(size_t i) {
+		check();
+		return ids[i];
+	}
+	short port(size_t i) {
+		check();
+		return ports[i];
+	}
+	long heartbeat(size_t i) {
+		check();
+		return heartbeats[i];
+	}
+	long timestamp(size_t i) {
+		check();
+		return timestamps[i];
+	}
+	MemberListEntry get(size_t i) {
+		check();
+		return MemberListEntry(ids[i], ports[i], heartbeats[i], timestamps[i]);
+	}
+	void set(size_t i, const MemberListEntry &entry);
+	// false if the view is at capacity
+	bool push_back(const MemberListEntry &entry) {
+		check();
+		if ( full() ) {
+			return false;
+		}
+		write(*count, entry);
+		indexAdd(*count);
+		addCandidate((*count)++);
+		return true;
+	}
+	void touch(size_t i, long heartbeat, long timestamp) {
+		check();
+		heartbeats[i] = heartbeat;
+		timestamps[i] = timestamp;
+		addCandidate(i);
+	}
+	void clear() {
+		check();
+		*count = 0;
+		reindex();
+	}
+	int find(int id, short port);
+	void erase(size_t i);
+	const uint64_t *staleMask(long limit);
+	void removeMasked(const uint64_t *mask);
+	bool isFresh(int id, short port, long cutoff);
+	int sampleFresh(int k, long cutoff);
+	// position of the jth entry of the last sampleFresh
+	int sampled(int j) {
+		check();
+		return alive[j];
+	}
+	uint64_t random();
+};
+
+/**
+ * CLASS NAME: NodeStore
+ *
+ * DESCRIPTION: Structure-of-arrays state of all the nodes of a run, indexed by node id - 1.
+ * 				Flags, counters and heartbeats are contiguous columns so the per-tick sweeps
+ * 				scan them without touching the views. The membership tables are pooled in
+ * 				four aligned view columns, node i owning the window of viewStride entries at
+ * 				viewStride * i, next to the index MemberList keeps over it. Inboxes are
+ * 				allocated when a node is first started, so nodes that never join cost no
+ * 				slots; event subscriptions when someone subscribes.
+ */
+class NodeStore {
+private:
+	int viewCapacity;
+	// viewCapacity rounded up to SCAN_LANES, so every window starts on a vector boundary
+	int viewStride;
+	vector<Address> addrs;
+	vector<uint8_t> flags;
+	vector<int> nnbs;
+	vector<long> heartbeats;
+	vector<int> pingCounters;
+	vector<int> timeOutCounters;
+	vector<int> backlogs;
+	vector<int> probesInFlight;
+	vector<long> lastSuspicions;
+	// entries in use of each view
+	vector<int> viewSizes;
+	vector<int, AlignedAllocator<int> > viewIds;
+	vector<short, AlignedAllocator<short> > viewPorts;
+	vector<long, AlignedAllocator<long> > viewHeartbeats;
+	vector<long, AlignedAllocator<long> > viewTimestamps;
+	// the mask of the last MemberList::staleMask
+	vector<uint64_t> scanMask;
+	// MemberList index: slotSize hash slots per node, viewStride candidates and positions per node
+	int slotSize;
+	vector<int> viewSlots;
+	vector<int> aliveLists;
+	vector<int> aliveCounts;
+	vector<int> alivePositions;
+	vector<uint64_t> rngStates;
+	uint64_t seed;
+	// bumped whenever the columns may move, which makes every MemberList taken before stale
+	unsigned int generation;
+	vector<Inbox *> inboxes;
+	// subscriptions to each node's view changes, NULL while there are none
+	vector<MemberEvents *> watchers;
+	friend class Member;
+	friend class MemberList;
+public:
+	NodeStore(int viewCapacity, uint64_t seed);
+	// Not copyable: the store owns the inboxes
+	NodeStore(const NodeStore &anotherStore) = delete;
+	NodeStore& operator =(const NodeStore &anotherStore) = delete;
+	virtual ~NodeStore();
+	int add();
+	void reserve(int nodes);
+	int size() {
+		return flags.size();
+	}
+	bool hasFlag(int i, uint8_t flag) {
+		return (flags[i] & flag) != 0;
+	}
+	void setFlag(int i, uint8_t flag, bool on) {
+		flags[i] = on ? (flags[i] | flag) : (flags[i] & ~flag);
+	}
+	bool isFailed(int i) {
+		return hasFlag(i, NODE_FAILED);
+	}
+	Inbox *inbox(int i);
+	bool checkpoint(Checkpoint &ck);
+};
+
 /**
  * CLASS NAME: Member
  *
- * DESCRIPTION: Class representing a member in the distributed system
+ * DESCRIPTION: Class representing a member in the distributed system: a handle on
+ * 				its row of the NodeStore, cheap to copy
  */
-// Declaration and definition here
 class Member {
+private:
+	NodeStore *store;
+	int index;
 public:
+	Member(): store(NULL), index(0) {}
+	Member(NodeStore *store, int index): store(store), index(index) {}
 	// This member's Address
-	Address addr;
-	// boolean indicating if this member is up
-	bool inited;
-	// boolean indicating if this member is in the group
-	bool inGroup;
-	// boolean indicating if this member has failed
-	bool bFailed;
+	Address &addr() {
+		return store->addrs[index];
+	}
+	// is this member up
+	bool isInited() {
+		return store->hasFlag(index, NODE_INITED);
+	}
+	void setInited(bool on) {
+		store->setFlag(index, NODE_INITED, on);
+	}
+	// is this member in the group
+	bool isInGroup() {
+		return store->hasFlag(index, NODE_INGROUP);
+	}
+	void setInGroup(bool on) {
+		store->setFlag(index, NODE_INGROUP, on);
+	}
+	// has this member failed
+	bool isFailed() {
+		return store->hasFlag(index, NODE_FAILED);
+	}
+	void setFailed(bool on) {
+		store->setFlag(index, NODE_FAILED, on);
+	}
 	// number of my neighbors
-	int nnb;
+	int &nnb() {
+		return store->nnbs[index];
+	}
 	// the node's own heartbeat
-	long heartbeat;
+	long &heartbeat() {
+		return store->heartbeats[index];
+	}
 	// counter for next ping
-	int pingCounter;
+	int &pingCounter() {
+		return store->pingCounters[index];
+	}
 	// counter for ping timeout
-	int timeOutCounter;
+	int &timeOutCounter() {
+		return store->timeOutCounters[index];
+	}
+	// view changes the adaptive scheduler has yet to spread
+	int &backlog() {
+		return store->backlogs[index];
+	}
+	// probes of the adaptive round a tick ago, whose replies cannot be back yet
+	int &probesInFlight() {
+		return store->probesInFlight[index];
+	}
+	// heartbeat at which the adaptive scheduler last took a suspicion for news
+	long &lastSuspicion() {
+		return store->lastSuspicions[index];
+	}
 	// Membership table
-	vector<MemberListEntry> memberList;
-	// My position in the membership table
-	vector<MemberListEntry>::iterator myPos;
+	MemberList memberList() {
+		return MemberList(store, index);
+	}
 	// Queue for failure detection messages
-	queue<q_elt> mp1q;
-	/**
-	 * Constructor
-	 */
-	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0) {}
-	// copy constructor
-	Member(const Member &anotherMember);
-	// Assignment operator overloading
-	Member& operator =(const Member &anotherMember);
-	virtual ~Member() {}
+	Inbox *mp1q() {
+		return store->inbox(index);
+	}
+	// Subscriptions to this member's view changes, NULL while nobody subscribes
+	MemberEvents *events() {
+		return store->watchers[index];
+	}
+	MemberEvents *watch() {
+		if ( store->watchers[index] == NULL ) {
+			store->watchers[index] = new MemberEvents();
+		}
+		return store->watchers[index];
+	}
+	// back to publishing nothing once the last subscription is gone
+	void unwatch() {
+		MemberEvents *&w = store->watchers[index];
+		if ( w != NULL && w->empty() ) {
+			delete w;
+			w = NULL;
+		}
+	}
 };
 
+/**
+ * Constructor: the window of node in store
+ */
+inline MemberList::MemberList(NodeStore *store, int node): store(store), generation(store->generation) {
+	size_t first = (size_t)store->viewStride * node;
+	ids = &store->viewIds[first];
+	ports = &store->viewPorts[first];
+	heartbeats = &store->viewHeartbeats[first];
+	timestamps = &store->viewTimestamps[first];
+	count = &store->viewSizes[node];
+	capacity = store->viewCapacity;
+	scratch = store->scanMask.data();
+	slots = &store->viewSlots[(size_t)store->slotSize * node];
+	slotMask = store->slotSize - 1;
+	alive = &store->aliveLists[first];
+	aliveCount = &store->aliveCounts[node];
+	alivePos = &store->alivePositions[first];
+	rng = &store->rngStates[node];
+}
+
+/**
+ * FUNCTION NAME: check
+ *
+ * DESCRIPTION: The columns have not moved since this list was taken
+ */
+inline void MemberList::check() {
+	assert(generation == store->generation);
+}
+
 #endif /* MEMBER_H_ */
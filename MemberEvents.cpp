@@ -0,0 +1,129 @@
+/**********************************
+ * FILE NAME: MemberEvents.cpp
+ *
+ * DESCRIPTION: Definition of the membership change subscriptions
+ **********************************/
+
+#include "MemberEvents.h"
+
+/**
+ * FUNCTION NAME: memberEventName
+ *
+ * DESCRIPTION: Lower-case name of an event type, for logs
+ */
+const char *memberEventName(int type) {
+	static const char *names[] = { "join", "suspect", "fail", "leave" };
+	return (type >= MEMBER_JOIN && type <= MEMBER_LEAVE) ? names[type] : "unknown";
+}
+
+/**
+ * FUNCTION NAME: push
+ *
+ * DESCRIPTION: Producer: append an event, false (and counted) if the queue is full
+ */
+bool MemberEventQueue::push(const MemberEvent &ev) {
+	size_t t = tail.load(memory_order_relaxed);
+	if ( t - head.load(memory_order_acquire) >= EVENT_QUEUE_CAPACITY ) {
+		overflows++;
+		return false;
+	}
+	events[t & (EVENT_QUEUE_CAPACITY - 1)] = ev;
+	tail.store(t + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: pop
+ *
+ * DESCRIPTION: Consumer: take the oldest event
+ *
+ * RETURNS:
+ * false if the queue is empty
+ */
+bool MemberEventQueue::pop(MemberEvent &ev) {
+	size_t h = head.load(memory_order_relaxed);
+	if ( h == tail.load(memory_order_acquire) ) {
+		return false;
+	}
+	ev = events[h & (EVENT_QUEUE_CAPACITY - 1)];
+	head.store(h + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * Destructor
+ */
+MemberEvents::~MemberEvents() {
+	delete queue;
+}
+
+/**
+ * FUNCTION NAME: subscribe
+ *
+ * DESCRIPTION: Call callback(env, event) for every view change from now on
+ *
+ * RETURNS:
+ * the subscription's id, for unsubscribe
+ */
+int MemberEvents::subscribe(MemberEventCallback callback, void *env) {
+	Subscriber s;
+	s.id = nextId++;
+	s.callback = callback;
+	s.env = env;
+	subscribers.push_back(s);
+	return s.id;
+}
+
+/**
+ * FUNCTION NAME: unsubscribe
+ *
+ * DESCRIPTION: Stop a callback subscription
+ *
+ * RETURNS:
+ * false if there is no subscription id
+ */
+bool MemberEvents::unsubscribe(int id) {
+	for ( size_t i = 0; i < subscribers.size(); i++ ) {
+		if ( subscribers[i].id == id ) {
+			subscribers.erase(subscribers.begin() + i);
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: openQueue
+ *
+ * DESCRIPTION: The queue every event is also pushed to, created on first use
+ */
+MemberEventQueue *MemberEvents::openQueue() {
+	if ( queue == NULL ) {
+		queue = new MemberEventQueue();
+	}
+	return queue;
+}
+
+/**
+ * FUNCTION NAME: closeQueue
+ *
+ * DESCRIPTION: Drop the queue and the events still in it; its consumer must be done with it
+ */
+void MemberEvents::closeQueue() {
+	delete queue;
+	queue = NULL;
+}
+
+/**
+ * FUNCTION NAME: publish
+ *
+ * DESCRIPTION: Hand an event to every callback, then to the queue
+ */
+void MemberEvents::publish(const MemberEvent &ev) {
+	for ( size_t i = 0; i < subscribers.size(); i++ ) {
+		subscribers[i].callback(subscribers[i].env, &ev);
+	}
+	if ( queue != NULL ) {
+		queue->push(ev);
+	}
+}
@@ -0,0 +1,113 @@
+/**********************************
+ * FILE NAME: MemberEvents.h
+ *
+ * DESCRIPTION: Membership change events and their subscriptions
+ **********************************/
+
+#ifndef _MEMBEREVENTS_H_
+#define _MEMBEREVENTS_H_
+
+#include "stdincludes.h"
+#include "NodeId.h"
+#include "Inbox.h"
+#include <atomic>
+
+/*
+ * Macros
+ */
+// events per queue, must be a power of two
+#define EVENT_QUEUE_CAPACITY 1024
+
+/**
+ * What happened to a member of a node's view
+ */
+enum MemberEventType {
+	// entered the view
+	MEMBER_JOIN,
+	// not heard of for TFAIL heartbeats, no longer gossiped or pinged
+	MEMBER_SUSPECT,
+	// not heard of for TREMOVE heartbeats, removed from the view
+	MEMBER_FAIL,
+	// dropped from the view without failing: evicted to make room, or the node itself left
+	MEMBER_LEAVE
+};
+
+/**
+ * STRUCT NAME: MemberEvent
+ *
+ * DESCRIPTION: One view change seen by observer at tick time
+ */
+typedef struct MemberEvent {
+	int type;
+	int time;
+	NodeId observer;
+	NodeId member;
+	// the member's last known heartbeat
+	long heartbeat;
+}MemberEvent;
+
+/**
+ * Subscriber callback, called synchronously by the observing node's protocol step.
+ * It must not unsubscribe from within the call.
+ */
+typedef void (*MemberEventCallback)(void *env, const MemberEvent *ev);
+
+/**
+ * CLASS NAME: MemberEventQueue
+ *
+ * DESCRIPTION: Bounded lock-free ring of events for one producer (the node's protocol step)
+ * 				and one consumer, which may run on another thread. Events that find it full
+ * 				are counted and dropped.
+ */
+class MemberEventQueue {
+private:
+	MemberEvent events[EVENT_QUEUE_CAPACITY];
+	char pad0[CACHE_LINE];
+	atomic<size_t> tail;
+	unsigned long overflows;
+	char pad1[CACHE_LINE];
+	atomic<size_t> head;
+public:
+	MemberEventQueue(): tail(0), overflows(0), head(0) {}
+	bool push(const MemberEvent &ev);
+	bool pop(MemberEvent &ev);
+	unsigned long getOverflows() {
+		return overflows;
+	}
+};
+
+/**
+ * CLASS NAME: MemberEvents
+ *
+ * DESCRIPTION: The subscriptions to one node's view changes: callbacks and at most one queue.
+ * 				A node nobody subscribes to has none, and publishes nothing.
+ */
+class MemberEvents {
+private:
+	typedef struct Subscriber {
+		int id;
+		MemberEventCallback callback;
+		void *env;
+	}Subscriber;
+	vector<Subscriber> subscribers;
+	MemberEventQueue *queue;
+	int nextId;
+public:
+	MemberEvents(): queue(NULL), nextId(1) {}
+	// Not copyable: owns the queue
+	MemberEvents(const MemberEvents &anotherEvents) = delete;
+	MemberEvents& operator =(const MemberEvents &anotherEvents) = delete;
+	virtual ~MemberEvents();
+	int subscribe(MemberEventCallback callback, void *env);
+	bool unsubscribe(int id);
+	MemberEventQueue *openQueue();
+	void closeQueue();
+	bool empty() {
+		return subscribers.empty() && queue == NULL;
+	}
+	void publish(const MemberEvent &ev);
+};
+
+const char *memberEventName(int type);
+
+#endif /* _MEMBEREVENTS_H_ */
@@ -0,0 +1,404 @@
+/**********************************
+ * FILE NAME: Metrics.cpp
+ *
+ * DESCRIPTION: Definition of the protocol-quality Metrics class
+ **********************************/
+
+#include "Metrics.h"
+
+/**
+ * Constructor
+ */
+Metrics::Metrics(): falseRemovals(0), removals(0), evictions(0), failedEvictions(0), partitioned(false), healTime(-1), windowFile(NULL), windowTicks(0),
+		windowEvery(0), lastMsgs(0), lastBytes(0) {}
+
+/**
+ * Destructor
+ */
+Metrics::~Metrics() {
+	if ( windowFile ) {
+		fclose(windowFile);
+	}
+}
+
+/**
+ * FUNCTION NAME: recordStart
+ *
+ * DESCRIPTION: Ground truth: node was introduced at time
+ */
+void Metrics::recordStart(NodeId node, int time) {
+	startTime[node] = time;
+	if ( windowFile ) {
+		downSince.erase(node);
+		bucketAt(time).starts++;
+	}
+}
+
+/**
+ * FUNCTION NAME: recordFailure
+ *
+ * DESCRIPTION: Ground truth: node failed at time
+ */
+void Metrics::recordFailure(NodeId node, int time) {
+	if ( failTime.find(node) == failTime.end() ) {
+		failTime[node] = time;
+	}
+	if ( windowFile ) {
+		downSince[node] = time;
+		bucketAt(time).failures++;
+	}
+}
+
+/**
+ * FUNCTION NAME: recordAdd
+ *
+ * DESCRIPTION: Node observer added node added to its view
+ */
+void Metrics::recordAdd(NodeId observer, NodeId added, int time) {
+	NodePair k(observer, added);
+	if ( firstAdd.find(k) == firstAdd.end() ) {
+		firstAdd[k] = time;
+	}
+	unordered_map<NodePair, int, NodePairHash>::iterator c = cutPairs.find(k);
+	if ( c != cutPairs.end() && c->second < 0 ) {
+		if ( partitioned ) {
+			// seen again from the same side, so it was not the partition
+			cutPairs.erase(c);
+		}
+		else {
+			c->second = time - healTime;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: recordRemove
+ *
+ * DESCRIPTION: Node observer removed node removed from its view.
+ * 				The first removal after the ground-truth failure is a detection,
+ * 				any removal of a node that is still up is a false removal.
+ */
+void Metrics::recordRemove(NodeId observer, NodeId removed, int time) {
+	unordered_map<NodeId, int>::iterator f = failTime.find(removed);
+	removals++;
+	if ( windowFile ) {
+		WindowBucket &b = bucketAt(time);
+		unordered_map<NodeId, int>::iterator d = downSince.find(removed);
+		if ( d == downSince.end() ) {
+			b.falseRemovals++;
+		}
+		else {
+			int &seen = detectedDown.insert(make_pair(NodePair(observer, removed), -1)).first->second;
+			if ( seen != d->second ) {
+				seen = d->second;
+				b.detections++;
+				b.latencySum += time - d->second;
+				b.latencyMax = max(b.latencyMax, time - d->second);
+			}
+		}
+	}
+	if ( f == failTime.end() || time < f->second ) {
+		falseRemovals++;
+		if ( partitioned ) {
+			cutPairs[NodePair(observer, removed)] = -1;
+		}
+		return;
+	}
+	NodePair k(observer, removed);
+	if ( firstRemove.find(k) == firstRemove.end() ) {
+		firstRemove[k] = time;
+	}
+}
+
+/**
+ * FUNCTION NAME: recordEvict
+ *
+ * DESCRIPTION: Node observer dropped node evicted from its full view to make room for another.
+ * 				Only counted: it says nothing about whether evicted is up.
+ */
+void Metrics::recordEvict(NodeId observer, NodeId evicted, int time) {
+	unordered_map<NodeId, int>::iterator f = failTime.find(evicted);
+	evictions++;
+	if ( f != failTime.end() && time >= f->second ) {
+		failedEvictions++;
+	}
+}
+
+/**
+ * FUNCTION NAME: recordPartition
+ *
+ * DESCRIPTION: A network partition was put in place at time
+ */
+void Metrics::recordPartition(int time) {
+	partitioned = true;
+}
+
+/**
+ * FUNCTION NAME: recordHeal
+ *
+ * DESCRIPTION: The network partition was lifted at time
+ */
+void Metrics::recordHeal(int time) {
+	partitioned = false;
+	healTime = time;
+}
+
+/**
+ * FUNCTION NAME: openWindows
+ *
+ * DESCRIPTION: Start writing a line every every ticks to file, covering the last ticks ticks
+ */
+void Metrics::openWindows(const char *file, int ticks, int every) {
+	windowFile = fopen(file, "w");
+	if ( windowFile == NULL ) {
+		return;
+	}
+	windowTicks = ticks;
+	windowEvery = every;
+	buckets.assign(ticks, WindowBucket());
+	fprintf(windowFile, "# every %d ticks, over the last %d ticks\n", every, ticks);
+	fprintf(windowFile, "#  tick  msgs/tick bytes/tick  view_acc  starts fails  detections lat_mean lat_max  false_removals\n");
+}
+
+/**
+ * FUNCTION NAME: bucketAt
+ *
+ * DESCRIPTION: Bucket of tick time
+ */
+WindowBucket &Metrics::bucketAt(int time) {
+	return buckets[time % windowTicks];
+}
+
+/**
+ * FUNCTION NAME: recordView
+ *
+ * DESCRIPTION: A running node's view has entries entries, alive of them for running nodes
+ */
+void Metrics::recordView(int time, int entries, int alive) {
+	if ( windowFile ) {
+		WindowBucket &b = bucketAt(time);
+		b.viewEntries += entries;
+		b.viewAlive += alive;
+	}
+}
+
+/**
+ * FUNCTION NAME: endTick
+ *
+ * DESCRIPTION: Close the bucket of tick time with the transport's running totals,
+ * 				write a report line if one is due and clear the bucket of the next tick
+ */
+void Metrics::endTick(int time, long long msgsSent, long long bytesSent) {
+	if ( windowFile == NULL ) {
+		return;
+	}
+	WindowBucket &cur = bucketAt(time);
+	cur.msgs = msgsSent - lastMsgs;
+	cur.bytes = bytesSent - lastBytes;
+	lastMsgs = msgsSent;
+	lastBytes = bytesSent;
+
+	if ( (time + 1) % windowEvery == 0 ) {
+		WindowBucket sum = WindowBucket();
+		int n = min(time + 1, windowTicks);
+		for ( int i = 0; i < n; i++ ) {
+			WindowBucket &b = buckets[i];
+			sum.msgs += b.msgs;
+			sum.bytes += b.bytes;
+			sum.viewEntries += b.viewEntries;
+			sum.viewAlive += b.viewAlive;
+			sum.detections += b.detections;
+			sum.latencySum += b.latencySum;
+			sum.latencyMax = max(sum.latencyMax, b.latencyMax);
+			sum.falseRemovals += b.falseRemovals;
+			sum.failures += b.failures;
+			sum.starts += b.starts;
+		}
+		fprintf(windowFile, "%7d %10.1f %10.1f  %8.3f  %6d %5d  %10d %8.2f %7d  %14d\n", time, (double)sum.msgs / n, (double)sum.bytes / n,
+				sum.viewEntries ? (double)sum.viewAlive / sum.viewEntries : 1.0, sum.starts, sum.failures, sum.detections,
+				sum.detections ? (double)sum.latencySum / sum.detections : 0.0, sum.latencyMax, sum.falseRemovals);
+		fflush(windowFile);
+	}
+	bucketAt(time + 1) = WindowBucket();
+}
+
+/**
+ * FUNCTION NAME: printDist
+ *
+ * DESCRIPTION: Print count/min/p50/p90/max/mean of a distribution of tick counts
+ */
+static void printDist(FILE *fp, const char *name, vector<int> &v) {
+	if ( v.empty() ) {
+		fprintf(fp, "%-24s n=0\n", name);
+		return;
+	}
+	sort(v.begin(), v.end());
+	double sum = 0;
+	for ( size_t i = 0; i < v.size(); i++ ) {
+		sum += v[i];
+	}
+	fprintf(fp, "%-24s n=%-5zu min=%-5d p50=%-5d p90=%-5d max=%-5d mean=%.2f\n", name, v.size(), v.front(),
+			v[(v.size() - 1) / 2], v[(size_t)((v.size() - 1) * 0.9)], v.back(), sum / v.size());
+}
+
+/**
+ * FUNCTION NAME: report
+ *
+ * DESCRIPTION: Write detection latency, accuracy, convergence and cost figures to file,
+ * 				and the headline numbers to summary if given
+ */
+void Metrics::report(const char *file, long long bytesSent, MetricsSummary *summary) {
+	vector<int> firstDetect, lastDetect, joinConverge;
+	int detectedFailures = 0;
+	int detections = 0, expectedDetections = 0;
+	int unconverged = 0;
+	int convergedAt = 0;
+
+	// Failure detection, over the observers that outlived the failed node
+	for ( unordered_map<NodeId, int>::iterator f = failTime.begin(); f != failTime.end(); ++f ) {
+		int first = -1, last = -1;
+		for ( unordered_map<NodeId, int>::iterator o = startTime.begin(); o != startTime.end(); ++o ) {
+			unordered_map<NodeId, int>::iterator of = failTime.find(o->first);
+			if ( o->first == f->first || (of != failTime.end() && of->second <= f->second) ) {
+				continue;
+			}
+			expectedDetections++;
+			unordered_map<NodePair, int, NodePairHash>::iterator r = firstRemove.find(NodePair(o->first, f->first));
+			if ( r == firstRemove.end() ) {
+				continue;
+			}
+			detections++;
+			int latency = r->second - f->second;
+			first = (first < 0 || latency < first) ? latency : first;
+			last = max(last, latency);
+		}
+		if ( first >= 0 ) {
+			detectedFailures++;
+			firstDetect.push_back(first);
+			lastDetect.push_back(last);
+		}
+	}
+
+	// Join convergence: time until every surviving node has seen the joiner at least once
+	for ( unordered_map<NodeId, int>::iterator s = startTime.begin(); s != startTime.end(); ++s ) {
+		if ( failTime.find(s->first) != failTime.end() ) {
+			continue;
+		}
+		int latency = 0;
+		bool converged = true;
+		for ( unordered_map<NodeId, int>::iterator o = startTime.begin(); converged && o != startTime.end(); ++o ) {
+			if ( o->first == s->first || failTime.find(o->first) != failTime.end() ) {
+				continue;
+			}
+			unordered_map<NodePair, int, NodePairHash>::iterator a = firstAdd.find(NodePair(o->first, s->first));
+			if ( a == firstAdd.end() ) {
+				converged = false;
+			}
+			else {
+				latency = max(latency, a->second - max(s->second, o->second));
+				convergedAt = max(convergedAt, a->second);
+			}
+		}
+		if ( converged ) {
+			joinConverge.push_back(latency);
+		}
+		else {
+			unconverged++;
+		}
+	}
+
+	if ( summary ) {
+		summary->started = startTime.size();
+		summary->failed = failTime.size();
+		summary->detections = detections;
+		summary->expectedDetections = expectedDetections;
+		summary->falseRemovals = falseRemovals;
+		summary->removals = removals;
+		summary->joinMean = -1;
+		if ( !joinConverge.empty() ) {
+			long sum = 0;
+			for ( size_t i = 0; i < joinConverge.size(); i++ ) {
+				sum += joinConverge[i];
+			}
+			summary->joinMean = (double)sum / joinConverge.size();
+		}
+		summary->unconverged = unconverged;
+		summary->bytesSent = bytesSent;
+	}
+
+	FILE *fp = fopen(file, "w");
+	if ( fp == NULL ) {
+		return;
+	}
+	fprintf(fp, "Protocol metrics (times in ticks)\n");
+	fprintf(fp, "nodes started            %zu\n", startTime.size());
+	fprintf(fp, "nodes failed             %zu\n", failTime.size());
+	printDist(fp, "first detection latency", firstDetect);
+	printDist(fp, "last detection latency", lastDetect);
+	fprintf(fp, "detections               %d of %d expected (%.1f%%)\n", detections, expectedDetections,
+			expectedDetections ? 100.0 * detections / expectedDetections : 0.0);
+	fprintf(fp, "false removals           %d of %d removals\n", falseRemovals, removals);
+	fprintf(fp, "evictions (full view)    %d, %d of failed nodes\n", evictions, failedEvictions);
+	printDist(fp, "join convergence", joinConverge);
+	fprintf(fp, "unconverged joins        %d\n", unconverged);
+	if ( unconverged == 0 ) {
+		fprintf(fp, "full view convergence at %d\n", convergedAt);
+	}
+	// Reconvergence after a partition heals: time until observers re-add the nodes they dropped meanwhile
+	if ( !cutPairs.empty() ) {
+		vector<int> healConverge;
+		int unhealed = 0;
+		for ( unordered_map<NodePair, int, NodePairHash>::iterator c = cutPairs.begin(); c != cutPairs.end(); ++c ) {
+			if ( failTime.find(c->first.first) != failTime.end() || failTime.find(c->first.second) != failTime.end() ) {
+				continue;
+			}
+			if ( c->second < 0 ) {
+				unhealed++;
+			}
+			else {
+				healConverge.push_back(c->second);
+			}
+		}
+		printDist(fp, "heal reconvergence", healConverge);
+		fprintf(fp, "links not re-added       %d\n", unhealed);
+	}
+	fprintf(fp, "bytes sent               %lld\n", bytesSent);
+	if ( detectedFailures ) {
+		fprintf(fp, "bytes per detected fail  %.0f\n", (double)bytesSent / detectedFailures);
+	}
+	else {
+		fprintf(fp, "bytes per detected fail  n/a\n");
+	}
+
+	fclose(fp);
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load everything measured so far. The window buckets are only taken over
+ * 				when the restoring run uses the same CHURN_WINDOW; its churn.log starts afresh.
+ */
+void Metrics::checkpoint(Checkpoint &ck) {
+	vector<WindowBucket> saved = buckets;
+
+	ck.podMap(startTime);
+	ck.podMap(failTime);
+	ck.podMap(firstAdd);
+	ck.podMap(firstRemove);
+	ck.pod(falseRemovals);
+	ck.pod(removals);
+	ck.pod(evictions);
+	ck.pod(failedEvictions);
+	ck.pod(partitioned);
+	ck.pod(healTime);
+	ck.podMap(cutPairs);
+	ck.podVector(saved);
+	ck.pod(lastMsgs);
+	ck.pod(lastBytes);
+	ck.podMap(downSince);
+	ck.podMap(detectedDown);
+	if ( ck.loading() && saved.size() == buckets.size() ) {
+		buckets = saved;
+	}
+}
@@ -0,0 +1,118 @@
+/**********************************
+ * FILE NAME: Metrics.h
+ *
+ * DESCRIPTION: Header file of the protocol-quality Metrics class
+ **********************************/
+
+#ifndef _METRICS_H_
+#define _METRICS_H_
+
+#include "stdincludes.h"
+#include "NodeId.h"
+#include "Checkpoint.h"
+#include <unordered_map>
+
+#define METRICS_LOG "metrics.log"
+
+/**
+ * STRUCT NAME: WindowBucket
+ *
+ * DESCRIPTION: What happened in one tick, for the sliding-window report
+ */
+typedef struct WindowBucket {
+	long long msgs;
+	long long bytes;
+	// view entries of the running nodes, and how many of them point to running nodes
+	long viewEntries;
+	long viewAlive;
+	int detections;
+	long latencySum;
+	int latencyMax;
+	int falseRemovals;
+	int failures;
+	int starts;
+}WindowBucket;
+
+/**
+ * STRUCT NAME: MetricsSummary
+ *
+ * DESCRIPTION: Headline numbers of a run, for the batch summary table
+ */
+typedef struct MetricsSummary {
+	int started;
+	int failed;
+	int detections;
+	int expectedDetections;
+	int falseRemovals;
+	int removals;
+	// mean join convergence in ticks, -1 if no join converged
+	double joinMean;
+	int unconverged;
+	long long bytesSent;
+}MetricsSummary;
+
+/**
+ * CLASS NAME: Metrics
+ *
+ * DESCRIPTION: Measures how well the membership protocol does its job.
+ * 				Ground truth (node start and failure times) comes from the application layer,
+ * 				observations come from the logNodeAdd/logNodeRemove events of every node.
+ */
+class Metrics {
+private:
+	typedef pair<NodeId, NodeId> NodePair;
+	struct NodePairHash {
+		size_t operator()(const NodePair &p) const {
+			return p.first.hash() ^ (p.second.hash() * 31);
+		}
+	};
+	// node -> time the node was started / failed
+	unordered_map<NodeId, int> startTime;
+	unordered_map<NodeId, int> failTime;
+	// (observer, subject) -> time of the first add / first removal after the subject failed
+	unordered_map<NodePair, int, NodePairHash> firstAdd;
+	unordered_map<NodePair, int, NodePairHash> firstRemove;
+	// removals of nodes that had not failed (at the time of the removal)
+	int falseRemovals;
+	int removals;
+	// members dropped to make room in a full view: not a verdict on the member, so not a removal
+	int evictions;
+	int failedEvictions;
+	// network partition in force, tick of the last heal (-1 before any)
+	bool partitioned;
+	int healTime;
+	// (observer, subject) dropped while partitioned -> ticks from the heal to the re-add, -1 until then
+	unordered_map<NodePair, int, NodePairHash> cutPairs;
+	/*
+	 * Sliding-window report: one bucket per tick of the window, a line every windowEvery ticks.
+	 * Unlike the totals above it follows restarts: a node is down from its latest failure to its next start.
+	 */
+	FILE *windowFile;
+	int windowTicks;
+	int windowEvery;
+	vector<WindowBucket> buckets;
+	long long lastMsgs;
+	long long lastBytes;
+	unordered_map<NodeId, int> downSince;
+	// (observer, subject) -> downSince value the observer already detected
+	unordered_map<NodePair, int, NodePairHash> detectedDown;
+	WindowBucket &bucketAt(int time);
+public:
+	Metrics();
+	virtual ~Metrics();
+	void recordStart(NodeId node, int time);
+	void recordFailure(NodeId node, int time);
+	// observations, overridden where they have to reach another process
+	virtual void recordAdd(NodeId observer, NodeId added, int time);
+	virtual void recordRemove(NodeId observer, NodeId removed, int time);
+	virtual void recordEvict(NodeId observer, NodeId evicted, int time);
+	void recordPartition(int time);
+	void recordHeal(int time);
+	void openWindows(const char *file, int ticks, int every);
+	void recordView(int time, int entries, int alive);
+	void endTick(int time, long long msgsSent, long long bytesSent);
+	void report(const char *file, long long bytesSent, MetricsSummary *summary = NULL);
+	void checkpoint(Checkpoint &ck);
+};
+
+#endif /* _METRICS_H_ */
@@ -0,0 +1,85 @@
+/**********************************
+ * FILE NAME: NodeId.h
+ *
+ * DESCRIPTION: Packed 64-bit node identifier (id + port)
+ **********************************/
+
+#ifndef _NODEID_H_
+#define _NODEID_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+
+/**
+ * CLASS NAME: NodeId
+ *
+ * DESCRIPTION: Value type holding a node's id and port in one integer.
+ * 				Compares and hashes in constant time; Address converts to and from it at the edges.
+ */
+class NodeId {
+public:
+	// (uint32 id << 16) | uint16 port
+	uint64_t key;
+	NodeId(): key(0) {}
+	NodeId(int id, short port): key(((uint64_t)(uint32_t)id << 16) | (uint16_t)port) {}
+	int getid() const {
+		return (int)(uint32_t)(key >> 16);
+	}
+	short getport() const {
+		return (short)(uint16_t)key;
+	}
+	bool isNull() const {
+		return key == 0;
+	}
+	bool operator ==(const NodeId &another) const {
+		return key == another.key;
+	}
+	bool operator !=(const NodeId &another) const {
+		return key != another.key;
+	}
+	bool operator <(const NodeId &another) const {
+		return key < another.key;
+	}
+	string toString() const {
+		return to_string(getid()) + ":" + to_string(getport());
+	}
+	/**
+	 * Parse "id:port", false if the string is malformed
+	 */
+	static bool parse(const char *s, NodeId &out) {
+		char *end;
+		long id = strtol(s, &end, 10);
+		if ( end == s || *end != ':' ) {
+			return false;
+		}
+		const char *p = end + 1;
+		long port = strtol(p, &end, 10);
+		if ( end == p ) {
+			return false;
+		}
+		out = NodeId((int)id, (short)port);
+		return true;
+	}
+	/**
+	 * 64-bit mix (splitmix64 finalizer), good enough for hash tables keyed by dense ids
+	 */
+	size_t hash() const {
+		uint64_t x = key;
+		x ^= x >> 30;
+		x *= 0xbf58476d1ce4e5b9ULL;
+		x ^= x >> 27;
+		x *= 0x94d049bb133111ebULL;
+		x ^= x >> 31;
+		return (size_t)x;
+	}
+};
+
+namespace std {
+	template<> struct hash<NodeId> {
+		size_t operator()(const NodeId &n) const {
+			return n.hash();
+		}
+	};
+}
+
+#endif /* _NODEID_H_ */
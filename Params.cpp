@@ -7,30 +7,97 @@
 #include "Params.h"
 
 /**
- * Constructor
+ * Constructor: the defaults of every key, so a conf file may give them in any order or leave them out
  */
-Params::Params(): PORTNUM(8001) {}
+Params::Params(): PORTNUM(8001) {
+	MAX_NNB = 10;
+	SINGLE_FAILURE = 1;
+	DROP_MSG = 0;
+	MSG_DROP_PROB = 0.1;
+	EN_GPSZ = 0;
+	STEP_RATE = .25;
+	MAX_MSG_SIZE = 4000;
+	globaltime = 0;
+	dropmsg = 0;
+	allNodesJoined = 0;
+	TRANSPORT = TRANSPORT_EMUL;
+	UDP_BASE_PORT = 9000;
+	LOCAL_NODE = 0;
+	TICK_MS = 0;
+	SHM_WORKERS = 0;
+	SEED = 0;
+	DELAY_MODEL = DELAY_NONE;
+	DELAY_MIN = 0;
+	DELAY_MAX = 0;
+	DELAY_JITTER = 0;
+	DELAY_MU = 0;
+	DELAY_SIGMA = 1;
+	LOG_PREFIX[0] = 0;
+	OUTDIR[0] = 0;
+	CHURN_RATE = 0;
+	CHURN_START = 150;
+	CHURN_JOIN = 0.1;
+	CHURN_WINDOW = 50;
+	CHURN_REPORT = 10;
+	SEND_RATE = 0;
+	SEND_BURST = 0;
+	RECV_RATE = 0;
+	RECV_BURST = 0;
+	INBOX_LIMIT = 0;
+	EN_BUFFSIZE = ENBUFFSIZE;
+	RESTORE_FROM[0] = 0;
+	TRACE_RECORD[0] = 0;
+	TRACE_REPLAY[0] = 0;
+	MEMBER_EVENTS = 0;
+	GOSSIP_MODE = GOSSIP_PUSH;
+	ZONE_GROUPS = 0;
+	ZONE_SIZE = 0;
+	ZONE_LINKS = 2;
+	ZONE_ROTATE = 10;
+	OVERLAY = OVERLAY_NONE;
+	ADAPTIVE = 0;
+	TIMELINE_FILE[0] = 0;
+}
 
 /**
  * FUNCTION NAME: setparams
  *
- * DESCRIPTION: Set the parameters for this test case
+ * DESCRIPTION: Set the parameters for this test case. settings are extra "KEY: value" lines
+ * 				applied after the conf file's own (batch runs use them for their grid values).
  */
-void Params::setparams(char *config_file) {
+void Params::setparams(char *config_file, const vector<string> &settings) {
 	FILE *fp = fopen(config_file,"r");
+	char key[64], value[256], line[512];
+	bool inTimeline = false;
 
-	fscanf(fp,"MAX_NNB: %d", &MAX_NNB);
-	fscanf(fp,"\nSINGLE_FAILURE: %d", &SINGLE_FAILURE);
-	fscanf(fp,"\nDROP_MSG: %d", &DROP_MSG);
-	fscanf(fp,"\nMSG_DROP_PROB: %lf", &MSG_DROP_PROB);
+	while ( fgets(line, sizeof(line), fp) ) {
+		if ( inTimeline ) {
+			if ( !TIMELINE.parseLine(line) ) {
+				printf("Bad timeline line %s ignored\n", line);
+			}
+		}
+		else if ( sscanf(line, " %63[^: ]: %255s", key, value) == 2 ) {
+			setparam(key, value);
+		}
+		else if ( sscanf(line, " %63[^: ]", key) == 1 && !strcmp(key, "TIMELINE") ) {
+			// every following line is a "<tick> <action> [args]" event
+			inTimeline = true;
+		}
+	}
+	for ( size_t i = 0; i < settings.size(); i++ ) {
+		if ( sscanf(settings[i].c_str(), " %63[^: ]: %255s", key, value) == 2 ) {
+			setparam(key, value);
+		}
+	}
+	if ( TIMELINE_FILE[0] && !TIMELINE.load(TIMELINE_FILE) ) {
+		printf("Cannot read TIMELINE_FILE %s\n", TIMELINE_FILE);
+	}
+	TIMELINE.sort();
+	ZONE_GROUPS = ZONES.empty() ? 0 : *max_element(ZONES.begin(), ZONES.end());
 
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
 	EN_GPSZ = MAX_NNB;
-	STEP_RATE=.25;
-	MAX_MSG_SIZE = 4000;
-	globaltime = 0;
-	dropmsg = 0;
 	allNodesJoined = 0;
 	for ( unsigned int i = 0; i < EN_GPSZ; i++ ) {
 		allNodesJoined += i;
@@ -39,6 +106,210 @@ void Params::setparams(char *config_file) {
 	return;
 }
 
+/**
+ * FUNCTION NAME: parseTimelineKey
+ *
+ * DESCRIPTION: One-line shorthands for timeline events
+ * 				PARTITION: 150@1-5/6-10		groups of node id ranges, split by '/'
+ * 				HEAL: 250
+ * 				LINK_LOSS: 120@3>4=0.5		directed link loss probability, 1 cuts the link
+ *
+ * RETURNS:
+ * false if value does not parse
+ */
+bool Params::parseTimelineKey(const char *key, const char *value) {
+	char line[320];
+	const char *at = strchr(value, '@');
+	const char *action = !strcmp(key, "PARTITION") ? "partition" : !strcmp(key, "HEAL") ? "heal" : "linkloss";
+
+	snprintf(line, sizeof(line), "%.*s %s %s", at ? (int)(at - value) : (int)strlen(value), value, action, at ? at + 1 : "");
+	return TIMELINE.parseLine(line);
+}
+
+/**
+ * FUNCTION NAME: setparam
+ *
+ * DESCRIPTION: Set one parameter from its conf file line
+ */
+void Params::setparam(const char *key, const char *value) {
+	if ( !strcmp(key, "MAX_NNB") ) {
+		MAX_NNB = atoi(value);
+	}
+	else if ( !strcmp(key, "SINGLE_FAILURE") ) {
+		SINGLE_FAILURE = atoi(value);
+	}
+	else if ( !strcmp(key, "DROP_MSG") ) {
+		DROP_MSG = atoi(value);
+	}
+	else if ( !strcmp(key, "MSG_DROP_PROB") ) {
+		MSG_DROP_PROB = atof(value);
+	}
+	else if ( !strcmp(key, "TRANSPORT") ) {
+		if ( !strcmp(value, "udp") ) {
+			TRANSPORT = TRANSPORT_UDP;
+		}
+		else if ( !strcmp(value, "shm") ) {
+			TRANSPORT = TRANSPORT_SHM;
+		}
+		else {
+			TRANSPORT = TRANSPORT_EMUL;
+		}
+	}
+	else if ( !strcmp(key, "UDP_BASE_PORT") ) {
+		UDP_BASE_PORT = atoi(value);
+	}
+	else if ( !strcmp(key, "DELAY_MODEL") ) {
+		if ( !strcmp(value, "fixed") ) {
+			DELAY_MODEL = DELAY_FIXED;
+		}
+		else if ( !strcmp(value, "uniform") ) {
+			DELAY_MODEL = DELAY_UNIFORM;
+		}
+		else if ( !strcmp(value, "lognormal") ) {
+			DELAY_MODEL = DELAY_LOGNORMAL;
+		}
+		else if ( !strcmp(value, "link") ) {
+			DELAY_MODEL = DELAY_LINK;
+		}
+		else {
+			DELAY_MODEL = DELAY_NONE;
+		}
+	}
+	else if ( !strcmp(key, "DELAY_MIN") ) {
+		DELAY_MIN = atoi(value);
+	}
+	else if ( !strcmp(key, "DELAY_MAX") ) {
+		DELAY_MAX = atoi(value);
+	}
+	else if ( !strcmp(key, "DELAY_JITTER") ) {
+		DELAY_JITTER = atoi(value);
+	}
+	else if ( !strcmp(key, "DELAY_MU") ) {
+		DELAY_MU = atof(value);
+	}
+	else if ( !strcmp(key, "DELAY_SIGMA") ) {
+		DELAY_SIGMA = atof(value);
+	}
+	else if ( !strcmp(key, "PARTITION") || !strcmp(key, "HEAL") || !strcmp(key, "LINK_LOSS") ) {
+		if ( !parseTimelineKey(key, value) ) {
+			printf("Bad %s value %s ignored\n", key, value);
+		}
+	}
+	else if ( !strcmp(key, "CHURN_RATE") ) {
+		CHURN_RATE = atof(value);
+	}
+	else if ( !strcmp(key, "CHURN_START") ) {
+		CHURN_START = atoi(value);
+	}
+	else if ( !strcmp(key, "CHURN_JOIN") ) {
+		CHURN_JOIN = atof(value);
+	}
+	else if ( !strcmp(key, "CHURN_WINDOW") ) {
+		CHURN_WINDOW = max(atoi(value), 1);
+	}
+	else if ( !strcmp(key, "CHURN_REPORT") ) {
+		CHURN_REPORT = max(atoi(value), 1);
+	}
+	else if ( !strcmp(key, "SEND_RATE") ) {
+		SEND_RATE = atof(value);
+	}
+	else if ( !strcmp(key, "SEND_BURST") ) {
+		SEND_BURST = atof(value);
+	}
+	else if ( !strcmp(key, "RECV_RATE") ) {
+		RECV_RATE = atof(value);
+	}
+	else if ( !strcmp(key, "RECV_BURST") ) {
+		RECV_BURST = atof(value);
+	}
+	else if ( !strcmp(key, "INBOX_LIMIT") ) {
+		INBOX_LIMIT = max(atoi(value), 0);
+	}
+	else if ( !strcmp(key, "EN_BUFFSIZE") ) {
+		EN_BUFFSIZE = max(atoi(value), 0);
+	}
+	else if ( !strcmp(key, "TIMELINE_FILE") ) {
+		strncpy(TIMELINE_FILE, value, sizeof(TIMELINE_FILE) - 1);
+		TIMELINE_FILE[sizeof(TIMELINE_FILE) - 1] = 0;
+	}
+	else if ( !strcmp(key, "CHECKPOINT_AT") ) {
+		// "100" or "100,200"
+		for ( const char *p = value; *p; p++ ) {
+			CHECKPOINT_AT.push_back(atoi(p));
+			if ( (p = strchr(p, ',')) == NULL ) {
+				break;
+			}
+		}
+	}
+	else if ( !strcmp(key, "RESTORE_FROM") ) {
+		strncpy(RESTORE_FROM, value, sizeof(RESTORE_FROM) - 1);
+		RESTORE_FROM[sizeof(RESTORE_FROM) - 1] = 0;
+	}
+	else if ( !strcmp(key, "OUTDIR") ) {
+		strncpy(OUTDIR, value, sizeof(OUTDIR) - 1);
+		OUTDIR[sizeof(OUTDIR) - 1] = 0;
+	}
+	else if ( !strcmp(key, "TRACE_RECORD") ) {
+		strncpy(TRACE_RECORD, value, sizeof(TRACE_RECORD) - 1);
+		TRACE_RECORD[sizeof(TRACE_RECORD) - 1] = 0;
+	}
+	else if ( !strcmp(key, "TRACE_REPLAY") ) {
+		strncpy(TRACE_REPLAY, value, sizeof(TRACE_REPLAY) - 1);
+		TRACE_REPLAY[sizeof(TRACE_REPLAY) - 1] = 0;
+	}
+	else if ( !strcmp(key, "MEMBER_EVENTS") ) {
+		MEMBER_EVENTS = atoi(value);
+	}
+	else if ( !strcmp(key, "GOSSIP_MODE") ) {
+		GOSSIP_MODE = !strcmp(value, "pushpull") ? GOSSIP_PUSHPULL : GOSSIP_PUSH;
+	}
+	else if ( !strcmp(key, "ZONES") ) {
+		if ( !Timeline::parseGroups(value, ZONES) ) {
+			printf("Bad ZONES %s ignored\n", value);
+			ZONES.clear();
+		}
+	}
+	else if ( !strcmp(key, "ZONE_SIZE") ) {
+		ZONE_SIZE = max(0, atoi(value));
+	}
+	else if ( !strcmp(key, "ZONE_LINKS") ) {
+		ZONE_LINKS = max(1, atoi(value));
+	}
+	else if ( !strcmp(key, "ZONE_ROTATE") ) {
+		ZONE_ROTATE = max(1, atoi(value));
+	}
+	else if ( !strcmp(key, "OVERLAY") ) {
+		OVERLAY = !strcmp(value, "ring") ? OVERLAY_RING : OVERLAY_NONE;
+	}
+	else if ( !strcmp(key, "ADAPTIVE") ) {
+		ADAPTIVE = atoi(value);
+	}
+	else if ( !strcmp(key, "SHM_WORKERS") ) {
+		SHM_WORKERS = atoi(value);
+	}
+	else if ( !strcmp(key, "TICK_MS") ) {
+		TICK_MS = atoi(value);
+	}
+	else if ( !strcmp(key, "SEED") ) {
+		SEED = (unsigned int)strtoul(value, NULL, 10);
+	}
+	else {
+		printf("Unknown parameter %s ignored\n", key);
+	}
+}
+
+/**
+ * FUNCTION NAME: logfile
+ *
+ * DESCRIPTION: Name of an output file, with this run's OUTDIR and prefix
+ */
+string Params::logfile(const char *name) {
+	if ( OUTDIR[0] ) {
+		return string(OUTDIR) + "/" + LOG_PREFIX + name;
+	}
+	return string(LOG_PREFIX) + name;
+}
+
 /**
  * FUNCTION NAME: getcurrtime
  *
@@ -48,3 +319,74 @@ void Params::setparams(char *config_file) {
 int Params::getcurrtime(){
     return globaltime;
 }
+
+/**
+ * FUNCTION NAME: zoneOf
+ *
+ * DESCRIPTION: Zone of a node id: its ZONES group, else its ZONE_SIZE range numbered after the
+ * 				groups, else 0
+ */
+int Params::zoneOf(int id) {
+	if ( id > 0 && id < (int)ZONES.size() && ZONES[id] ) {
+		return ZONES[id];
+	}
+	if ( ZONE_SIZE > 0 && id > 0 ) {
+		return ZONE_GROUPS + 1 + (id - 1) / ZONE_SIZE;
+	}
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: zoneIntroducer
+ *
+ * DESCRIPTION: Lowest id of the zone of id, the zone's introducer
+ */
+int Params::zoneIntroducer(int id) {
+	int zone = zoneOf(id);
+	int first = 1;
+
+	if ( ZONE_SIZE > 0 && (id >= (int)ZONES.size() || !ZONES[id]) ) {
+		first = (id - 1) / ZONE_SIZE * ZONE_SIZE + 1;
+	}
+	for ( int i = first; i < id; i++ ) {
+		if ( zoneOf(i) == zone ) {
+			return i;
+		}
+	}
+	return id;
+}
+
+/**
+ * FUNCTION NAME: zoneCapacity
+ *
+ * DESCRIPTION: Members of the largest zone, which a node's view of its own zone has room for
+ * 				(at least itself and one more)
+ */
+int Params::zoneCapacity() {
+	vector<int> sizes;
+	int largest = ZONE_SIZE;
+
+	for ( size_t id = 1; id < ZONES.size(); id++ ) {
+		if ( ZONES[id] >= (int)sizes.size() ) {
+			sizes.resize(ZONES[id] + 1, 0);
+		}
+		if ( ZONES[id] ) {
+			largest = max(largest, ++sizes[ZONES[id]]);
+		}
+	}
+	return max(largest, 2);
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load what the run itself changes: the clock, the drop rate and the timeline.
+ * 				Everything else comes from the conf file, so a sweep can resume a checkpoint with new values.
+ */
+void Params::checkpoint(Checkpoint &ck) {
+	ck.pod(globaltime);
+	ck.pod(dropmsg);
+	ck.pod(MSG_DROP_PROB);
+	ck.pod(allNodesJoined);
+	TIMELINE.checkpoint(ck);
+}
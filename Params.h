@@ -9,10 +9,33 @@
 
 #include "stdincludes.h"
 #include "Params.h"
-#include "Member.h"
+#include "Timeline.h"
+
+// default EN_BUFFSIZE, the classic EmulNet buffer
+#define ENBUFFSIZE 30000
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
 
+/**
+ * Backends selectable with "TRANSPORT:" in the conf file
+ */
+enum TransportType { TRANSPORT_EMUL, TRANSPORT_UDP, TRANSPORT_SHM };
+
+/**
+ * Latency models of EmulNet, selected with "DELAY_MODEL:"
+ */
+enum DelayModel { DELAY_NONE, DELAY_FIXED, DELAY_UNIFORM, DELAY_LOGNORMAL, DELAY_LINK };
+
+/**
+ * Exchanges of the periodic ping, selected with "GOSSIP_MODE:"
+ */
+enum GossipMode { GOSSIP_PUSH, GOSSIP_PUSHPULL };
+
+/**
+ * How a node picks its ping targets, selected with "OVERLAY:"
+ */
+enum Overlay { OVERLAY_NONE, OVERLAY_RING };
+
 /**
  * CLASS NAME: Params
  *
@@ -31,9 +54,72 @@ public:
 	int globaltime;
 	int allNodesJoined;
 	short PORTNUM;
+	/*
+	 * Further "KEY: value" lines, all optional
+	 */
+	int TRANSPORT;				// TransportType: emul (default), udp or shm
+	int UDP_BASE_PORT;			// node id N listens on 127.0.0.1:UDP_BASE_PORT+N
+	int LOCAL_NODE;				// id of the only node run by this process, 0 = all nodes
+	int TICK_MS;				// wall-clock length of a tick, 0 = run flat out
+	int SHM_WORKERS;			// worker processes of the shm transport, 0 = one per node
+	unsigned int SEED;			// random seed, 0 = seed from the clock
+	int DELAY_MODEL;			// DelayModel: none (default), fixed, uniform, lognormal or link
+	int DELAY_MIN;				// extra ticks in flight: fixed delay, or lower bound
+	int DELAY_MAX;				// upper bound of uniform, range of the per link delays
+	int DELAY_JITTER;			// link: uniform extra 0..DELAY_JITTER ticks per message
+	double DELAY_MU;			// lognormal: DELAY_MIN + lognormal(DELAY_MU, DELAY_SIGMA) ticks
+	double DELAY_SIGMA;
+	char LOG_PREFIX[32];		// prepended to every log file name
+	char OUTDIR[256];			// directory of every log file, empty = current directory
+	double CHURN_RATE;			// churn events per tick (Poisson), 0 = no churn
+	int CHURN_START;			// tick the churn starts at
+	double CHURN_JOIN;			// fraction of churn events that join a new node id
+	int CHURN_WINDOW;			// ticks covered by every line of churn.log
+	int CHURN_REPORT;			// ticks between two lines of churn.log
+	double SEND_RATE;			// emul: messages per tick a node may send (token bucket), 0 = unlimited
+	double SEND_BURST;			// emul: send bucket size, at least max(SEND_RATE, 1)
+	double RECV_RATE;			// emul: messages per tick a node may take in, the rest wait queued
+	double RECV_BURST;			// emul: receive bucket size, at least max(RECV_RATE, 1)
+	int INBOX_LIMIT;			// emul: most messages queued for one node, 0 = unbounded
+	int EN_BUFFSIZE;			// emul: most messages in flight in the whole network, 0 = unbounded
+	char TIMELINE_FILE[256];	// event file read after the TIMELINE section of the conf file
+	Timeline TIMELINE;			// scripted joins, failures and network faults
+	vector<int> CHECKPOINT_AT;	// emul: ticks at the end of which the whole simulation is saved
+	char RESTORE_FROM[256];		// emul: checkpoint file to resume from instead of starting at tick 0
+	char TRACE_RECORD[256];		// emul: write every send/receive decision and timeline event to this file
+	char TRACE_REPLAY[256];		// emul: take them from this file instead of the RNGs and the timeline
+	int MEMBER_EVENTS;			// 1 = subscribe to every node's view changes and write them to events.log
+	int GOSSIP_MODE;			// GossipMode: push (default, whole views) or pushpull (digests, then differing buckets)
+	vector<int> ZONES;			// zone of every id listed in "ZONES: 1-5/6-10", 0 = not listed
+	int ZONE_GROUPS;			// zones listed in ZONES
+	int ZONE_SIZE;				// ids not listed in ZONES: 1..n, n+1..2n, ... share a zone; 0 = they share one zone
+	int ZONE_LINKS;				// zoned: most members of other zones in a view
+	int ZONE_ROTATE;			// zoned: ticks a zone keeps its representative
+	int OVERLAY;				// Overlay: none (default, random targets) or ring (successors and fingers)
+	int ADAPTIVE;				// 1 = probe interval and fan-out follow view size, loss and churn; 0 = one probe per tick
 	Params();
-	void setparams(char *);
+	void setparams(char *, const vector<string> &settings = vector<string>());
+	void setparam(const char *key, const char *value);
+	bool parseTimelineKey(const char *key, const char *value);
+	string logfile(const char *name);
 	int getcurrtime();
+	/**
+	 * Two-tier gossip: ZONES or ZONE_SIZE is set
+	 */
+	bool zoned() {
+		return ZONE_SIZE > 0 || !ZONES.empty();
+	}
+	/**
+	 * Views hold more than a gossip message: zoned, or flat under the ring overlay, which needs
+	 * the whole membership to place on its ring
+	 */
+	bool wideViews() {
+		return zoned() || OVERLAY == OVERLAY_RING;
+	}
+	int zoneOf(int id);
+	int zoneIntroducer(int id);
+	int zoneCapacity();
+	void checkpoint(Checkpoint &ck);
 };
 
 #endif /* _PARAMS_H_ */
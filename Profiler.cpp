@@ -0,0 +1,163 @@
+/**********************************
+ * FILE NAME: Profiler.cpp
+ *
+ * DESCRIPTION: Definition of the per-phase tick profiler
+ **********************************/
+
+#include "Profiler.h"
+
+#ifdef PROFILE
+
+static const char *phaseNames[PROF_NUM_PHASES] = { "recvLoop", "checkMessages", "nodeLoopOps", "LOG", "fail" };
+
+// collects whatever a thread times before binding its own profiler
+static Profiler unbound;
+thread_local Profiler *Profiler::current = &unbound;
+
+/**
+ * Constructor
+ */
+Profiler::Profiler() {
+	memset(tickNs, 0, sizeof(tickNs));
+}
+
+/**
+ * FUNCTION NAME: use
+ *
+ * DESCRIPTION: Charge the timings of the calling thread to profiler from now on
+ */
+void Profiler::use(Profiler *profiler) {
+	current = profiler ? profiler : &unbound;
+}
+
+/**
+ * FUNCTION NAME: now
+ *
+ * DESCRIPTION: Monotonic clock in nanoseconds
+ */
+uint64_t Profiler::now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Charge ns nanoseconds to the given phase and node
+ */
+void Profiler::add(ProfPhase phase, int node, uint64_t ns) {
+	Profiler *p = current;
+	p->tickNs[phase] += ns;
+	if ( node < 0 ) {
+		return;
+	}
+	if ( node >= (int)p->nodeProf.size() ) {
+		p->nodeProf.resize(node + 1);
+	}
+	p->nodeProf[node].ns[phase] += ns;
+	p->nodeProf[node].calls[phase]++;
+}
+
+/**
+ * FUNCTION NAME: endTick
+ *
+ * DESCRIPTION: Close the current tick. Called once per tick by the application layer.
+ */
+void Profiler::endTick() {
+	for ( int p = 0; p < PROF_NUM_PHASES; p++ ) {
+		current->perTick[p].push_back(current->tickNs[p]);
+		current->tickNs[p] = 0;
+	}
+}
+
+/**
+ * FUNCTION NAME: percentile
+ *
+ * DESCRIPTION: Return the pct-th percentile of a sorted vector
+ */
+static uint64_t percentile(const vector<uint64_t> &sorted, double pct) {
+	if ( sorted.empty() ) {
+		return 0;
+	}
+	size_t idx = (size_t)(pct / 100.0 * (sorted.size() - 1) + 0.5);
+	return sorted[idx];
+}
+
+/**
+ * FUNCTION NAME: dump
+ *
+ * DESCRIPTION: Write the per-phase histograms and the node hot-spot table to file
+ */
+void Profiler::dump(const char *file) {
+	vector<uint64_t> *perTick = current->perTick;
+	vector<NodeProf> &nodeProf = current->nodeProf;
+	FILE *fp = fopen(file, "w");
+	if ( fp == NULL ) {
+		return;
+	}
+
+	fprintf(fp, "Per-tick phase latency (us)\n");
+	fprintf(fp, "%-14s %6s %12s %10s %10s %10s\n", "phase", "ticks", "total", "p50", "p99", "max");
+	for ( int p = 0; p < PROF_NUM_PHASES; p++ ) {
+		vector<uint64_t> sorted = perTick[p];
+		uint64_t total = 0;
+		sort(sorted.begin(), sorted.end());
+		for ( size_t i = 0; i < sorted.size(); i++ ) {
+			total += sorted[i];
+		}
+		fprintf(fp, "%-14s %6zu %12.1f %10.2f %10.2f %10.2f\n", phaseNames[p], sorted.size(), total / 1e3,
+				percentile(sorted, 50) / 1e3, percentile(sorted, 99) / 1e3, (sorted.empty() ? 0 : sorted.back()) / 1e3);
+	}
+
+	// log2 histogram of per-tick totals, bucket b holds [2^b, 2^(b+1)) ns
+	fprintf(fp, "\nPer-tick histogram (ticks per log2 ns bucket)\n");
+	for ( int p = 0; p < PROF_NUM_PHASES; p++ ) {
+		int hist[64] = { 0 };
+		int maxb = 0;
+		for ( size_t i = 0; i < perTick[p].size(); i++ ) {
+			int b = 0;
+			uint64_t v = perTick[p][i];
+			while ( v >>= 1 ) {
+				b++;
+			}
+			hist[b]++;
+			maxb = max(maxb, b);
+		}
+		fprintf(fp, "%-14s", phaseNames[p]);
+		for ( int b = 0; b <= maxb; b++ ) {
+			if ( hist[b] ) {
+				fprintf(fp, " 2^%d:%d", b, hist[b]);
+			}
+		}
+		fprintf(fp, "\n");
+	}
+
+	// Hot spots: nodes ranked by time spent in their own tick work (LOG is nested, shown apart)
+	vector<pair<uint64_t, int> > ranked;
+	for ( size_t n = 0; n < nodeProf.size(); n++ ) {
+		uint64_t own = nodeProf[n].ns[PROF_RECVLOOP] + nodeProf[n].ns[PROF_CHECKMESSAGES] + nodeProf[n].ns[PROF_NODELOOPOPS];
+		if ( own ) {
+			ranked.push_back(make_pair(own, (int)n));
+		}
+	}
+	sort(ranked.rbegin(), ranked.rend());
+	fprintf(fp, "\nHot nodes (us, calls)\n");
+	fprintf(fp, "%6s %12s", "node", "total");
+	for ( int p = 0; p < PROF_NUM_PHASES; p++ ) {
+		fprintf(fp, " %20s", phaseNames[p]);
+	}
+	fprintf(fp, "\n");
+	for ( size_t i = 0; i < ranked.size() && i < PROF_TOP_NODES; i++ ) {
+		NodeProf &np = nodeProf[ranked[i].second];
+		fprintf(fp, "%6d %12.1f", ranked[i].second, ranked[i].first / 1e3);
+		for ( int p = 0; p < PROF_NUM_PHASES; p++ ) {
+			fprintf(fp, " %12.1f (%5llu)", np.ns[p] / 1e3, (unsigned long long)np.calls[p]);
+		}
+		fprintf(fp, "\n");
+	}
+
+	fclose(fp);
+}
+
+#endif /* PROFILE */
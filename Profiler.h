@@ -0,0 +1,99 @@
+/**********************************
+ * FILE NAME: Profiler.h
+ *
+ * DESCRIPTION: Per-phase tick profiler.
+ * 				Everything here compiles to nothing unless PROFILE is defined
+ * 				(build with "make PROFILE=1").
+ **********************************/
+
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+
+#define PROFILE_LOG "profile.log"
+// number of nodes listed in the hot-spot table
+#define PROF_TOP_NODES 10
+
+/**
+ * Phases of a tick that are timed separately
+ */
+enum ProfPhase {
+	PROF_RECVLOOP,
+	PROF_CHECKMESSAGES,
+	PROF_NODELOOPOPS,
+	PROF_LOG,
+	PROF_FAIL,
+	PROF_NUM_PHASES
+};
+
+#ifdef PROFILE
+
+/**
+ * Per node counters, indexed by node id
+ */
+typedef struct NodeProf {
+	uint64_t ns[PROF_NUM_PHASES];
+	uint64_t calls[PROF_NUM_PHASES];
+}NodeProf;
+
+/**
+ * CLASS NAME: Profiler
+ *
+ * DESCRIPTION: Aggregates scoped timings into per-tick phase totals and per-node counters.
+ * 				Phases nest (LOG is called from inside NODELOOPOPS), so phase times are inclusive.
+ * 				Every simulation owns one and binds it to the thread running it with use();
+ * 				the static calls go to the instance bound to the calling thread.
+ */
+class Profiler {
+private:
+	// time spent in each phase during the current tick
+	uint64_t tickNs[PROF_NUM_PHASES];
+	// one total per finished tick and phase
+	vector<uint64_t> perTick[PROF_NUM_PHASES];
+	vector<NodeProf> nodeProf;
+	static thread_local Profiler *current;
+public:
+	Profiler();
+	static void use(Profiler *profiler);
+	static uint64_t now();
+	static void add(ProfPhase phase, int node, uint64_t ns);
+	static void endTick();
+	static void dump(const char *file);
+};
+
+/**
+ * CLASS NAME: ProfScope
+ *
+ * DESCRIPTION: Times the enclosing scope and charges it to (phase, node)
+ */
+class ProfScope {
+private:
+	ProfPhase phase;
+	int node;
+	uint64_t start;
+public:
+	ProfScope(ProfPhase phase, int node): phase(phase), node(node), start(Profiler::now()) {}
+	~ProfScope() {
+		Profiler::add(phase, node, Profiler::now() - start);
+	}
+};
+
+#define PROF_CONCAT2(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT2(a, b)
+#define PROF_SCOPE(phase, node) ProfScope PROF_CONCAT(profScope, __LINE__)(phase, node)
+#define PROF_USE(profiler) Profiler::use(profiler)
+#define PROF_TICK() Profiler::endTick()
+#define PROF_DUMP(file) Profiler::dump(file)
+
+#else
+
+#define PROF_SCOPE(phase, node)
+#define PROF_USE(profiler)
+#define PROF_TICK()
+#define PROF_DUMP(file)
+
+#endif /* PROFILE */
+
+#endif /* _PROFILER_H_ */
@@ -1,7 +1,7 @@
 /**********************************
  * FILE NAME: Queue.h
  *
- * DESCRIPTION: Header file for std::<queue> related functions
+ * DESCRIPTION: Header file for Inbox related functions
  **********************************/
 
 #ifndef QUEUE_H_
@@ -13,16 +13,15 @@
 /**
  * Class name: Queue
  *
- * Description: This function wraps std::queue related functions
+ * Description: This function wraps the Inbox related functions
  */
 class Queue {
 public:
 	Queue() {}
 	virtual ~Queue() {}
-	static bool enqueue(queue<q_elt> *queue, void *buffer, int size) {
-		q_elt element(buffer, size);
-		queue->emplace(element);
-		return true;
+	// Copies the message into the inbox, false if the inbox is full
+	static bool enqueue(Inbox *inbox, void *buffer, int size) {
+		return inbox->push((char *)buffer, size);
 	}
 };
 
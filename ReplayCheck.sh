@@ -0,0 +1,39 @@
+#**********************
+#*
+#* Progam Name: MP1. Membership Protocol.
+#*
+#* Current file: ReplayCheck.sh
+#* About this file: Trace record/replay check.
+#*
+#***********************
+#!/bin/bash
+
+# Records every emul test case without a SEED, in each gossip mode, then replays the trace
+# under another SEED: dbg.log and msgcount.log have to come out byte-identical.
+
+modes=("" "GOSSIP_MODE: pushpull" "ZONE_SIZE: 3" "OVERLAY: ring" "ADAPTIVE: 1")
+dir=$(mktemp -d)
+failed=0
+
+make > /dev/null || exit 1
+for conf in testcases/*.conf; do
+	if grep -q "^TRANSPORT" $conf; then
+		continue
+	fi
+	for mode in "${modes[@]}"; do
+		name="$(basename $conf .conf) ${mode:-push}"
+		# keys go first: a TIMELINE section runs to the end of the file
+		(echo "$mode"; echo "OUTDIR: $dir/rec"; echo "TRACE_RECORD: $dir/trace.bin"; cat $conf) > $dir/rec.conf
+		(echo "$mode"; echo "OUTDIR: $dir/rep"; echo "TRACE_REPLAY: $dir/trace.bin"; echo "SEED: 99"; cat $conf) > $dir/rep.conf
+		rm -rf $dir/rec $dir/rep
+		./Application $dir/rec.conf > /dev/null
+		if ! ./Application $dir/rep.conf > $dir/rep.out || ! cmp -s $dir/rec/dbg.log $dir/rep/dbg.log || ! cmp -s $dir/rec/msgcount.log $dir/rep/msgcount.log; then
+			echo "FAIL $name: $(grep -m1 "out of step" $dir/rep.out)"
+			failed=1
+		else
+			echo "ok   $name"
+		fi
+	done
+done
+rm -rf $dir
+exit $failed
@@ -0,0 +1,300 @@
+/**********************************
+ * FILE NAME: ShmNet.cpp
+ *
+ * DESCRIPTION: Shared-memory transport backend definition
+ **********************************/
+
+#include "ShmNet.h"
+#include <sched.h>
+
+/**
+ * Constructor: create, size and map the segment for EN_GPSZ nodes
+ */
+ShmNet::ShmNet(Params *p): par(p), nextid(1) {
+	char name[64];
+	int nodes = par->EN_GPSZ;
+
+	segsize = sizeof(ShmHeader) + (nodes + 1) * sizeof(ShmNodeStats) + (nodes + 1) * sizeof(ShmRing) +
+			(nodes + 1) * sizeof(ShmObservations);
+	sprintf(name, "/mp1shm.%d", (int)getpid());
+	int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if ( fd < 0 || ftruncate(fd, segsize) < 0 ) {
+		perror("shm_open");
+		exit(1);
+	}
+	void *seg = mmap(NULL, segsize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if ( seg == MAP_FAILED ) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+	// forked workers inherit the mapping, nobody needs the name any more
+	shm_unlink(name);
+
+	// ftruncate zero-filled the segment: counters, flags and ring indices start at 0
+	hdr = (ShmHeader *)seg;
+	stats = (ShmNodeStats *)(hdr + 1);
+	rings = (ShmRing *)(stats + nodes + 1);
+	observations = (ShmObservations *)(rings + nodes + 1);
+	hdr->tick.store(-1);
+	hdr->nodes = nodes;
+	for ( int n = 0; n <= nodes; n++ ) {
+		for ( size_t i = 0; i < SHM_RING_SLOTS; i++ ) {
+			rings[n].slots[i].seq.store(i);
+		}
+	}
+	seed = par->SEED ? par->SEED : (unsigned int)time(NULL);
+	dropRng.seed(seed + 1);
+}
+
+/**
+ * Destructor
+ */
+ShmNet::~ShmNet() {
+	munmap(hdr, segsize);
+}
+
+/**
+ * FUNCTION NAME: ringOf
+ *
+ * DESCRIPTION: Ring of node id, NULL for ids outside the segment
+ */
+ShmRing *ShmNet::ringOf(int id) {
+	if ( id <= 0 || id > hdr->nodes ) {
+		return NULL;
+	}
+	return &rings[id];
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Assign the next node id (done by the coordinator, before forking)
+ */
+void *ShmNet::ENinit(Address *myaddr, short port) {
+	*myaddr = Address(NodeId(nextid++, 0));
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: ENsend
+ *
+ * DESCRIPTION: Copy the message into the destination's ring
+ *
+ * RETURNS:
+ * size, 0 if the message was dropped
+ */
+int ShmNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
+	int src = myaddr->getNodeId().getid();
+	ShmRing *ring = ringOf(toaddr->getNodeId().getid());
+	int sendmsg = uniform_int_distribution<int>(0, 99)(dropRng);
+
+	if ( ring == NULL || ringOf(src) == NULL || size > SHM_SLOT_SIZE || size >= par->MAX_MSG_SIZE ||
+			(hdr->dropmsg.load(memory_order_relaxed) && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+		return 0;
+	}
+
+	size_t pos = ring->tail.load(memory_order_relaxed);
+	ShmSlot *slot;
+	for ( ;; ) {
+		slot = &ring->slots[pos & (SHM_RING_SLOTS - 1)];
+		size_t seq = slot->seq.load(memory_order_acquire);
+		long dif = (long)seq - (long)pos;
+		if ( dif == 0 ) {
+			if ( ring->tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed) ) {
+				break;
+			}
+		}
+		else if ( dif < 0 ) {
+			// ring full: the receiver is slow or dead
+			stats[src].dropped.fetch_add(1, memory_order_relaxed);
+			return 0;
+		}
+		else {
+			pos = ring->tail.load(memory_order_relaxed);
+		}
+	}
+	slot->size = size;
+	slot->from = src;
+	memcpy(slot->data, data, size);
+	slot->seq.store(pos + 1, memory_order_release);
+
+	stats[src].sent.fetch_add(1, memory_order_relaxed);
+	hdr->sent_bytes.fetch_add(size, memory_order_relaxed);
+	hdr->sent_msgs.fetch_add(1, memory_order_relaxed);
+	return size;
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Drain the node's ring into its inbox
+ *
+ * RETURN:
+ * 0
+ */
+int ShmNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue) {
+	int dst = myaddr->getNodeId().getid();
+	ShmRing *ring = ringOf(dst);
+	long n = 0;
+
+	if ( ring == NULL ) {
+		return 0;
+	}
+	for ( ;; ) {
+		ShmSlot *slot = &ring->slots[ring->head & (SHM_RING_SLOTS - 1)];
+		if ( slot->seq.load(memory_order_acquire) != ring->head + 1 ) {
+			break;
+		}
+		(*enq)(queue, slot->data, slot->size);
+		slot->seq.store(ring->head + SHM_RING_SLOTS, memory_order_release);
+		ring->head++;
+		n++;
+	}
+	stats[dst].recv.fetch_add(n, memory_order_relaxed);
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: openTick
+ *
+ * DESCRIPTION: Coordinator: let the workers run tick, publishing the current drop setting
+ */
+void ShmNet::openTick(int tick) {
+	hdr->dropmsg.store(par->dropmsg, memory_order_relaxed);
+	hdr->arrived.store(0, memory_order_relaxed);
+	hdr->tick.store(tick, memory_order_release);
+}
+
+/**
+ * FUNCTION NAME: waitForTick
+ *
+ * DESCRIPTION: Worker: wait until the coordinator opens tick
+ */
+void ShmNet::waitForTick(int tick) {
+	while ( hdr->tick.load(memory_order_acquire) < tick ) {
+		sched_yield();
+	}
+}
+
+/**
+ * FUNCTION NAME: arrive
+ *
+ * DESCRIPTION: Worker: done with the current tick
+ */
+void ShmNet::arrive() {
+	hdr->arrived.fetch_add(1, memory_order_release);
+}
+
+/**
+ * FUNCTION NAME: waitForArrivals
+ *
+ * DESCRIPTION: Coordinator: wait until the given number of workers finished the current tick
+ */
+void ShmNet::waitForArrivals(int workers) {
+	while ( hdr->arrived.load(memory_order_acquire) < workers ) {
+		sched_yield();
+	}
+}
+
+/**
+ * FUNCTION NAME: markFailed
+ *
+ * DESCRIPTION: Coordinator: fail (or, for a restart, clear) node id; its worker picks this up
+ * 				at the start of the next tick
+ */
+void ShmNet::markFailed(int id, bool failed) {
+	if ( ringOf(id) ) {
+		stats[id].failed.store(failed ? 1 : 0, memory_order_relaxed);
+	}
+}
+
+/**
+ * FUNCTION NAME: isFailed
+ *
+ * DESCRIPTION: Was node id failed by the coordinator
+ */
+bool ShmNet::isFailed(int id) {
+	return ringOf(id) && stats[id].failed.load(memory_order_relaxed);
+}
+
+/**
+ * FUNCTION NAME: seedWorker
+ *
+ * DESCRIPTION: Worker: the forked generator is the coordinator's, give this worker its own drops
+ */
+void ShmNet::seedWorker(int worker) {
+	dropRng.seed(seed + 2 + worker);
+}
+
+/**
+ * FUNCTION NAME: postObservation
+ *
+ * DESCRIPTION: Worker: node observer logged an add, remove or eviction of subject at time
+ */
+void ShmNet::postObservation(int kind, NodeId observer, NodeId subject, int time) {
+	int id = observer.getid();
+	if ( ringOf(id) == NULL ) {
+		return;
+	}
+	ShmObservations &o = observations[id];
+	if ( o.count == SHM_OBS_SLOTS ) {
+		o.lost++;
+		return;
+	}
+	o.obs[o.count].kind = kind;
+	o.obs[o.count].subject = subject.getid();
+	o.obs[o.count].time = time;
+	o.count++;
+}
+
+/**
+ * FUNCTION NAME: drainObservations
+ *
+ * DESCRIPTION: Coordinator, once the workers finished the tick: hand their observations to metrics
+ */
+void ShmNet::drainObservations(Metrics *metrics) {
+	for ( int id = 1; id <= hdr->nodes; id++ ) {
+		ShmObservations &o = observations[id];
+		for ( int i = 0; i < o.count; i++ ) {
+			NodeId observer(id, 0), subject(o.obs[i].subject, 0);
+			if ( o.obs[i].kind == SHM_OBS_ADD ) {
+				metrics->recordAdd(observer, subject, o.obs[i].time);
+			}
+			else if ( o.obs[i].kind == SHM_OBS_REMOVE ) {
+				metrics->recordRemove(observer, subject, o.obs[i].time);
+			}
+			else {
+				metrics->recordEvict(observer, subject, o.obs[i].time);
+			}
+		}
+		o.count = 0;
+	}
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Coordinator: write the per node counts of all processes to msgcount.log
+ */
+int ShmNet::ENcleanup() {
+	long sent = 0, recv = 0, dropped = 0, lost = 0;
+	FILE* file = fopen(par->logfile(MSGCOUNT_LOG).c_str(), "w+");
+
+	for ( int i = 1; i <= hdr->nodes; i++ ) {
+		fprintf(file, "node %3d sent_total %6ld  recv_total %6ld  ring_full_drops %6ld%s\n", i, stats[i].sent.load(),
+				stats[i].recv.load(), stats[i].dropped.load(), stats[i].failed.load() ? "  (failed)" : "");
+		sent += stats[i].sent.load();
+		recv += stats[i].recv.load();
+		dropped += stats[i].dropped.load();
+		lost += observations[i].lost;
+	}
+	fprintf(file, "\nshm messages sent %ld recv %ld ring_full_drops %ld bytes %lld\n", sent, recv, dropped, hdr->sent_bytes.load());
+	if ( lost ) {
+		fprintf(file, "metric observations lost %ld\n", lost);
+	}
+	fclose(file);
+
+	PROF_DUMP(par->logfile(PROFILE_LOG).c_str());
+	return 0;
+}
@@ -0,0 +1,193 @@
+/**********************************
+ * FILE NAME: ShmNet.h
+ *
+ * DESCRIPTION: Shared-memory transport backend header file
+ **********************************/
+
+#ifndef _SHMNET_H_
+#define _SHMNET_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "Transport.h"
+#include "Profiler.h"
+#include "Metrics.h"
+#include <atomic>
+#include <random>
+#include <sys/mman.h>
+
+/*
+ * Macros
+ */
+// slots in every node's ring, must be a power of two
+#define SHM_RING_SLOTS 256
+// largest message a slot carries; a slot is then 256 bytes
+#define SHM_SLOT_SIZE 240
+// metric observations a node can pass to the coordinator in one tick
+#define SHM_OBS_SLOTS 256
+
+/*
+ * Kinds of metric observation
+ */
+enum ShmObsKind { SHM_OBS_ADD, SHM_OBS_REMOVE, SHM_OBS_EVICT };
+
+/**
+ * STRUCT NAME: ShmSlot
+ *
+ * DESCRIPTION: One message in a shared ring
+ */
+typedef struct ShmSlot {
+	atomic<size_t> seq;
+	int size;
+	int from;
+	char data[SHM_SLOT_SIZE];
+}ShmSlot;
+
+/**
+ * STRUCT NAME: ShmRing
+ *
+ * DESCRIPTION: Bounded multi-producer / single-consumer ring living in the shared segment.
+ * 				Same sequence-number scheme as MPSCInbox, but with the slots inline so the ring
+ * 				holds no pointers and works at any mapping address.
+ */
+typedef struct ShmRing {
+	atomic<size_t> tail;
+	char pad0[CACHE_LINE - sizeof(atomic<size_t>)];
+	// only touched by the owning node's process
+	size_t head;
+	char pad1[CACHE_LINE - sizeof(size_t)];
+	ShmSlot slots[SHM_RING_SLOTS];
+}ShmRing;
+
+/**
+ * STRUCT NAME: ShmNodeStats
+ *
+ * DESCRIPTION: Per node counters, one cache line each
+ */
+typedef struct ShmNodeStats {
+	atomic<long> sent;
+	atomic<long> recv;
+	atomic<long> dropped;
+	// set by the coordinator when the node is failed
+	atomic<int> failed;
+	char pad[CACHE_LINE - 3 * sizeof(atomic<long>) - sizeof(atomic<int>)];
+}ShmNodeStats;
+
+/**
+ * STRUCT NAME: ShmObservation
+ *
+ * DESCRIPTION: An add, remove or eviction of subject logged by a node at time
+ */
+typedef struct ShmObservation {
+	int kind;
+	int subject;
+	int time;
+}ShmObservation;
+
+/**
+ * STRUCT NAME: ShmObservations
+ *
+ * DESCRIPTION: Adds, removes and evictions one node logged in the current tick, for the coordinator's
+ * 				Metrics. Written by the node's worker during the tick, read by the coordinator after
+ * 				the barrier, so it needs no atomics.
+ */
+typedef struct ShmObservations {
+	int count;
+	// observations that did not fit, over the whole run
+	long lost;
+	ShmObservation obs[SHM_OBS_SLOTS];
+}ShmObservations;
+
+/**
+ * STRUCT NAME: ShmHeader
+ *
+ * DESCRIPTION: Start of the shared segment: tick barrier and global state
+ */
+typedef struct ShmHeader {
+	// tick the workers may run
+	atomic<int> tick;
+	char pad0[CACHE_LINE - sizeof(atomic<int>)];
+	// workers done with the current tick
+	atomic<int> arrived;
+	char pad1[CACHE_LINE - sizeof(atomic<int>)];
+	// mirrors Params::dropmsg of the coordinator
+	atomic<int> dropmsg;
+	atomic<long long> sent_bytes;
+	atomic<long long> sent_msgs;
+	int nodes;
+}ShmHeader;
+
+/**
+ * CLASS NAME: ShmNet
+ *
+ * DESCRIPTION: Transport for running nodes in separate processes on one host.
+ * 				One POSIX shared-memory segment holds a lock-free ring per node, the per node counters
+ * 				and metric observations, and the tick barrier. The segment is mapped before the workers are forked, so every
+ * 				process sees it at the same address; the name is unlinked right after mapping.
+ */
+class ShmNet : public Transport {
+private:
+	Params *par;
+	int nextid;
+	size_t segsize;
+	ShmHeader *hdr;
+	ShmNodeStats *stats;
+	ShmRing *rings;
+	ShmObservations *observations;
+	// draws of the emulated drop rate, reseeded in each worker
+	unsigned int seed;
+	mt19937 dropRng;
+	ShmRing *ringOf(int id);
+public:
+	ShmNet(Params *p);
+	ShmNet(const ShmNet &anotherShmNet) = delete;
+	ShmNet& operator = (const ShmNet &anotherShmNet) = delete;
+	virtual ~ShmNet();
+	using Transport::ENsend;
+	void *ENinit(Address *myaddr, short port);
+	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
+	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	int ENcleanup();
+	long long getSentBytes() {
+		return hdr->sent_bytes.load();
+	}
+	long long getSentMessages() {
+		return hdr->sent_msgs.load();
+	}
+	// Tick barrier: the coordinator opens a tick, the workers wait for it and report back
+	void openTick(int tick);
+	void waitForTick(int tick);
+	void arrive();
+	void waitForArrivals(int workers);
+	void markFailed(int id, bool failed = true);
+	bool isFailed(int id);
+	void seedWorker(int worker);
+	// Metrics of the workers, replayed by the coordinator
+	void postObservation(int kind, NodeId observer, NodeId subject, int time);
+	void drainObservations(Metrics *metrics);
+};
+
+/**
+ * CLASS NAME: ShmMetrics
+ *
+ * DESCRIPTION: Metrics of a worker process. Its nodes' adds, removes and evictions go through the
+ * 				segment to the coordinator, which has the ground truth and writes metrics.log.
+ */
+class ShmMetrics : public Metrics {
+private:
+	ShmNet *shm;
+public:
+	ShmMetrics(ShmNet *s): shm(s) {}
+	void recordAdd(NodeId observer, NodeId added, int time) {
+		shm->postObservation(SHM_OBS_ADD, observer, added, time);
+	}
+	void recordRemove(NodeId observer, NodeId removed, int time) {
+		shm->postObservation(SHM_OBS_REMOVE, observer, removed, time);
+	}
+	void recordEvict(NodeId observer, NodeId evicted, int time) {
+		shm->postObservation(SHM_OBS_EVICT, observer, evicted, time);
+	}
+};
+
+#endif /* _SHMNET_H_ */
@@ -0,0 +1,223 @@
+/**********************************
+ * FILE NAME: Timeline.cpp
+ *
+ * DESCRIPTION: Definition of the scripted failure/churn Timeline
+ **********************************/
+
+#include "Timeline.h"
+
+/**
+ * Constructor
+ */
+Timeline::Timeline(): cursor(0) {}
+
+/**
+ * FUNCTION NAME: parseGroups
+ *
+ * DESCRIPTION: "1-5/6-10,12" -> labels[id]: ranges split by ',' share a group, groups are split by '/'
+ *
+ * RETURNS:
+ * false if str does not parse
+ */
+bool Timeline::parseGroups(const char *str, vector<int> &labels) {
+	const char *p = str;
+	char *end;
+	int label = 1;
+
+	labels.clear();
+	while ( *p ) {
+		int lo = strtol(p, &end, 10), hi = lo;
+		if ( end == p || lo < 1 ) {
+			return false;
+		}
+		if ( *end == '-' ) {
+			p = end + 1;
+			hi = strtol(p, &end, 10);
+			if ( end == p ) {
+				return false;
+			}
+		}
+		if ( hi >= (int)labels.size() ) {
+			labels.resize(hi + 1, 0);
+		}
+		for ( int id = lo; id <= hi; id++ ) {
+			labels[id] = label;
+		}
+		if ( *end == '/' ) {
+			label++;
+		}
+		else if ( *end != ',' && *end != 0 ) {
+			return false;
+		}
+		p = *end ? end + 1 : end;
+	}
+	return !labels.empty();
+}
+
+/**
+ * FUNCTION NAME: parseLine
+ *
+ * DESCRIPTION: Add the event of one "<tick> <action> [args]" line; blank and '#' lines are skipped
+ *
+ * RETURNS:
+ * false if the line does not parse
+ */
+bool Timeline::parseLine(const char *line) {
+	TimelineEvent ev;
+	char action[32], arg[256];
+	int n;
+
+	while ( isspace(*line) ) {
+		line++;
+	}
+	if ( *line == 0 || *line == '#' ) {
+		return true;
+	}
+
+	arg[0] = 0;
+	n = sscanf(line, "%d %31s %255s", &ev.time, action, arg);
+	if ( n < 2 || ev.time < 0 ) {
+		return false;
+	}
+	ev.node = ev.src = ev.dst = 0;
+	ev.value = 0;
+
+	if ( !strcmp(action, "join") || !strcmp(action, "restart") || !strcmp(action, "crash") || !strcmp(action, "leave") ) {
+		ev.action = !strcmp(action, "join") ? TL_JOIN : !strcmp(action, "restart") ? TL_RESTART :
+				!strcmp(action, "crash") ? TL_CRASH : TL_LEAVE;
+		ev.node = atoi(arg);
+		if ( ev.node < 1 ) {
+			return false;
+		}
+	}
+	else if ( !strcmp(action, "drop") ) {
+		ev.action = TL_DROP;
+		ev.value = atof(arg);
+	}
+	else if ( !strcmp(action, "partition") ) {
+		ev.action = TL_PARTITION;
+		if ( !parseGroups(arg, ev.labels) ) {
+			return false;
+		}
+	}
+	else if ( !strcmp(action, "heal") ) {
+		ev.action = TL_HEAL;
+	}
+	else if ( !strcmp(action, "linkloss") ) {
+		ev.action = TL_LINKLOSS;
+		if ( sscanf(arg, "%d>%d=%lf", &ev.src, &ev.dst, &ev.value) != 3 ) {
+			return false;
+		}
+	}
+	else {
+		return false;
+	}
+
+	add(ev);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: load
+ *
+ * DESCRIPTION: Add every line of an event file
+ *
+ * RETURNS:
+ * false if the file cannot be read; bad lines are reported and skipped
+ */
+bool Timeline::load(const char *file) {
+	char line[512];
+	FILE *fp = fopen(file, "r");
+
+	if ( fp == NULL ) {
+		return false;
+	}
+	while ( fgets(line, sizeof(line), fp) ) {
+		if ( !parseLine(line) ) {
+			printf("Bad timeline line %s ignored\n", line);
+		}
+	}
+	fclose(fp);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Append an event; sort() must run before the timeline is consumed
+ */
+void Timeline::add(const TimelineEvent &ev) {
+	events.push_back(ev);
+}
+
+/**
+ * FUNCTION NAME: sort
+ *
+ * DESCRIPTION: Order by tick, events before the nodes run first; same-tick events keep their order
+ */
+void Timeline::sort() {
+	stable_sort(events.begin(), events.end(), [](const TimelineEvent &a, const TimelineEvent &b) {
+		if ( a.time != b.time ) {
+			return a.time < b.time;
+		}
+		return runsBeforeTick(a.action) && !runsBeforeTick(b.action);
+	});
+	cursor = 0;
+}
+
+/**
+ * FUNCTION NAME: has
+ *
+ * DESCRIPTION: Is there any event of this action
+ */
+bool Timeline::has(int action) {
+	for ( size_t i = 0; i < events.size(); i++ ) {
+		if ( events[i].action == action ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: next
+ *
+ * DESCRIPTION: Pop the next event due by tick. Before the nodes run only JOIN and RESTART are popped,
+ * 				after they ran everything due is.
+ */
+TimelineEvent *Timeline::next(int tick, bool beforeRun) {
+	if ( cursor >= events.size() || events[cursor].time > tick ) {
+		return NULL;
+	}
+	if ( beforeRun && !runsBeforeTick(events[cursor].action) ) {
+		return NULL;
+	}
+	return &events[cursor++];
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Save or load every event and the cursor
+ */
+void Timeline::checkpoint(Checkpoint &ck) {
+	uint64_t n = events.size();
+	uint64_t pos = cursor;
+
+	ck.pod(n);
+	ck.pod(pos);
+	if ( ck.loading() ) {
+		events.assign(ck.good() ? n : 0, TimelineEvent());
+		cursor = pos;
+	}
+	for ( size_t i = 0; i < events.size(); i++ ) {
+		TimelineEvent &ev = events[i];
+		ck.pod(ev.time);
+		ck.pod(ev.action);
+		ck.pod(ev.node);
+		ck.pod(ev.src);
+		ck.pod(ev.dst);
+		ck.pod(ev.value);
+		ck.podVector(ev.labels);
+	}
+}
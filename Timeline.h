@@ -0,0 +1,73 @@
+/**********************************
+ * FILE NAME: Timeline.h
+ *
+ * DESCRIPTION: Header file of the scripted failure/churn Timeline
+ **********************************/
+
+#ifndef _TIMELINE_H_
+#define _TIMELINE_H_
+
+#include "stdincludes.h"
+#include "Checkpoint.h"
+
+/**
+ * Timeline actions. JOIN and RESTART take effect before the nodes run in their tick,
+ * the others after, where Application::fail used to inject its canned failures.
+ */
+enum TimelineAction { TL_JOIN, TL_RESTART, TL_CRASH, TL_LEAVE, TL_DROP, TL_PARTITION, TL_HEAL, TL_LINKLOSS };
+
+/**
+ * STRUCT NAME: TimelineEvent
+ *
+ * DESCRIPTION: One scheduled event
+ */
+typedef struct TimelineEvent {
+	int time;
+	int action;
+	// TL_JOIN, TL_RESTART, TL_CRASH, TL_LEAVE
+	int node;
+	// TL_LINKLOSS: directed link src -> dst
+	int src;
+	int dst;
+	// TL_DROP: drop probability, TL_LINKLOSS: loss probability of the link (0 turns it off)
+	double value;
+	// TL_PARTITION: label of every node id, nodes only talk within a label (0 = unlisted)
+	vector<int> labels;
+}TimelineEvent;
+
+/**
+ * CLASS NAME: Timeline
+ *
+ * DESCRIPTION: Events read from the TIMELINE section of the conf file or from TIMELINE_FILE,
+ * 				one per line: "<tick> <action> [args]"
+ * 					join <id>, restart <id>, crash <id>, leave <id>
+ * 					drop <prob>, partition 1-5/6-10, heal, linkloss <src>><dst>=<prob>
+ * 				Sorted once, then consumed with a cursor: each tick costs O(1) plus the events due.
+ */
+class Timeline {
+private:
+	vector<TimelineEvent> events;
+	size_t cursor;
+public:
+	Timeline();
+	static bool parseGroups(const char *str, vector<int> &labels);
+	bool parseLine(const char *line);
+	bool load(const char *file);
+	void add(const TimelineEvent &ev);
+	void sort();
+	bool has(int action);
+	size_t size() {
+		return events.size();
+	}
+	const TimelineEvent &at(size_t k) {
+		return events[k];
+	}
+	// Next event due by tick in the given phase, NULL if there is none
+	TimelineEvent *next(int tick, bool beforeRun);
+	void checkpoint(Checkpoint &ck);
+	static bool runsBeforeTick(int action) {
+		return action == TL_JOIN || action == TL_RESTART;
+	}
+};
+
+#endif /* _TIMELINE_H_ */
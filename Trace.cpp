@@ -0,0 +1,223 @@
+/**********************************
+ * FILE NAME: Trace.cpp
+ *
+ * DESCRIPTION: Definition of the message Trace (record and replay)
+ **********************************/
+
+#include "Trace.h"
+
+/**
+ * Constructor
+ */
+Trace::Trace(): fp(NULL), writing(false), used(0), pos(0), peeked(false) {}
+
+/**
+ * Destructor
+ */
+Trace::~Trace() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Start recording to file, or replaying from it. The nodes' seed is written to
+ * 				the header when recording, and read back from it when replaying.
+ *
+ * RETURNS:
+ * false if the file cannot be opened (errno says why) or is not a trace (errno 0)
+ */
+bool Trace::open(const char *file, bool record, uint64_t &seed) {
+	char magic[sizeof(TRACE_MAGIC)];
+
+	close();
+	fp = fopen(file, record ? "wb" : "rb");
+	if ( fp == NULL ) {
+		return false;
+	}
+	writing = record;
+	used = pos = 0;
+	peeked = false;
+	if ( record ) {
+		put(TRACE_MAGIC, sizeof(magic));
+		put(&seed, sizeof(seed));
+		return true;
+	}
+	if ( !get(magic, sizeof(magic)) || memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0 || !get(&seed, sizeof(seed)) ) {
+		close();
+		errno = 0;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Write out what is buffered and close the file
+ */
+void Trace::close() {
+	if ( fp == NULL ) {
+		return;
+	}
+	flush();
+	fclose(fp);
+	fp = NULL;
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Recording: write the buffer to the file
+ */
+void Trace::flush() {
+	if ( writing && used > 0 ) {
+		fwrite(buffer, 1, used, fp);
+		used = 0;
+	}
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Append bytes, writing the buffer out when it is full
+ */
+void Trace::put(const void *data, size_t size) {
+	if ( used + size > TRACE_BUFFER ) {
+		flush();
+	}
+	memcpy(buffer + used, data, size);
+	used += size;
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Take the next bytes, refilling the buffer from the file as needed
+ *
+ * RETURNS:
+ * false at the end of the trace
+ */
+bool Trace::get(void *data, size_t size) {
+	if ( pos + size > used ) {
+		memmove(buffer, buffer + pos, used - pos);
+		used -= pos;
+		pos = 0;
+		used += fread(buffer + used, 1, TRACE_BUFFER - used, fp);
+		if ( size > used ) {
+			return false;
+		}
+	}
+	memcpy(data, buffer + pos, size);
+	pos += size;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Record one decision
+ */
+void Trace::write(int tick, int kind, int verdict, int src, int dst, int size, int due) {
+	TraceRecord rec;
+
+	rec.tick = tick;
+	rec.kind = kind;
+	rec.verdict = verdict;
+	rec.src = src;
+	rec.dst = dst;
+	rec.size = size;
+	rec.due = due;
+	put(&rec, sizeof(rec));
+}
+
+/**
+ * FUNCTION NAME: writeEvent
+ *
+ * DESCRIPTION: Record a timeline event as it is applied
+ */
+void Trace::writeEvent(int tick, const TimelineEvent &ev) {
+	write(tick, TR_EVENT, ev.action, ev.src, ev.dst, ev.node, ev.labels.size());
+	put(&ev.value, sizeof(ev.value));
+	for ( size_t i = 0; i < ev.labels.size(); i++ ) {
+		int32_t label = ev.labels[i];
+		put(&label, sizeof(label));
+	}
+}
+
+/**
+ * FUNCTION NAME: peek
+ *
+ * DESCRIPTION: Replaying: the next record without taking it, NULL at the end of the trace
+ */
+const TraceRecord *Trace::peek() {
+	if ( !peeked ) {
+		peeked = get(&next, sizeof(next));
+	}
+	return peeked ? &next : NULL;
+}
+
+/**
+ * FUNCTION NAME: expect
+ *
+ * DESCRIPTION: Replaying: take the next record, which has to be the kind of decision
+ * 				the run is making now, for the same tick, nodes and (sends) payload size
+ */
+TraceRecord Trace::expect(int kind, int tick, int src, int dst, int size) {
+	const TraceRecord *rec = peek();
+
+	if ( rec == NULL || rec->kind != kind || rec->tick != tick || rec->src != src || (kind == TR_SEND && (rec->dst != dst || rec->size != size)) ) {
+		outOfStep(kind == TR_SEND ? "send" : "receive", tick, src, dst);
+	}
+	peeked = false;
+	return next;
+}
+
+/**
+ * FUNCTION NAME: readEvent
+ *
+ * DESCRIPTION: Replaying: take the next record if it is a timeline event
+ *
+ * RETURNS:
+ * false if the next record is not an event
+ */
+bool Trace::readEvent(TimelineEvent &ev) {
+	const TraceRecord *rec = peek();
+	int32_t label;
+
+	if ( rec == NULL || rec->kind != TR_EVENT ) {
+		return false;
+	}
+	peeked = false;
+	ev.time = next.tick;
+	ev.action = next.verdict;
+	ev.src = next.src;
+	ev.dst = next.dst;
+	ev.node = next.size;
+	ev.labels.clear();
+	bool ok = get(&ev.value, sizeof(ev.value));
+	for ( int i = 0; i < next.due && ok; i++ ) {
+		ok = get(&label, sizeof(label));
+		ev.labels.push_back(label);
+	}
+	if ( !ok ) {
+		outOfStep("event", next.tick, next.size, 0);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: outOfStep
+ *
+ * DESCRIPTION: The replayed run no longer makes the recorded decisions: stop
+ */
+void Trace::outOfStep(const char *what, int tick, int src, int dst) {
+	if ( peeked ) {
+		printf("Trace out of step at tick %d: %s %d -> %d, recorded kind %d at tick %d %d -> %d\n",
+				tick, what, src, dst, next.kind, next.tick, next.src, next.dst);
+	}
+	else {
+		printf("Trace out of step at tick %d: %s %d -> %d past the end of the trace\n", tick, what, src, dst);
+	}
+	exit(1);
+}
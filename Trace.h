@@ -0,0 +1,88 @@
+/**********************************
+ * FILE NAME: Trace.h
+ *
+ * DESCRIPTION: Header file of the message Trace (record and replay)
+ **********************************/
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include "stdincludes.h"
+#include "Timeline.h"
+#include <stdint.h>
+
+#define TRACE_MAGIC "MP1TRC02"
+// bytes buffered before a write or after a read
+#define TRACE_BUFFER 65536
+
+/**
+ * Record kinds
+ */
+enum TraceKind { TR_SEND, TR_RECV, TR_EVENT };
+
+/**
+ * What EmulNet decided for one target of a send
+ */
+enum TraceVerdict { TR_DELIVER, TR_LOSS, TR_BUFFER, TR_PARTITION, TR_LINKLOSS, TR_THROTTLE };
+
+/**
+ * STRUCT NAME: TraceRecord
+ *
+ * DESCRIPTION: One decision, 24 bytes
+ * 				TR_SEND:  verdict, src -> dst, payload size, delivery tick (TR_DELIVER)
+ * 				TR_RECV:  node in src, messages handed over in size
+ * 				TR_EVENT: timeline action in verdict, its src/dst, its node in size, number of
+ * 				          partition labels in due; the value and the labels follow the record
+ */
+typedef struct TraceRecord {
+	int32_t tick;
+	int16_t kind;
+	int16_t verdict;
+	int32_t src;
+	int32_t dst;
+	int32_t size;
+	int32_t due;
+}TraceRecord;
+
+/**
+ * CLASS NAME: Trace
+ *
+ * DESCRIPTION: Binary trace of every EmulNet send and receive decision and every timeline event
+ * 				of a run. Recording appends through a TRACE_BUFFER byte buffer; replaying hands
+ * 				the same decisions back in order, so no RNG is drawn. The header keeps the seed of
+ * 				the nodes' own generators, which the replay reuses. A replay that asks for a
+ * 				different decision than the next recorded one is out of step and stops the run.
+ */
+class Trace {
+private:
+	FILE *fp;
+	bool writing;
+	char buffer[TRACE_BUFFER];
+	// bytes in buffer, and the read position when replaying
+	size_t used;
+	size_t pos;
+	bool peeked;
+	TraceRecord next;
+	void put(const void *data, size_t size);
+	bool get(void *data, size_t size);
+	void outOfStep(const char *what, int tick, int src, int dst);
+public:
+	Trace();
+	virtual ~Trace();
+	bool open(const char *file, bool record, uint64_t &seed);
+	void close();
+	bool recording() {
+		return fp != NULL && writing;
+	}
+	bool replaying() {
+		return fp != NULL && !writing;
+	}
+	void write(int tick, int kind, int verdict, int src, int dst, int size, int due);
+	void writeEvent(int tick, const TimelineEvent &ev);
+	const TraceRecord *peek();
+	TraceRecord expect(int kind, int tick, int src, int dst, int size);
+	bool readEvent(TimelineEvent &ev);
+	void flush();
+};
+
+#endif /* _TRACE_H_ */
@@ -0,0 +1,64 @@
+/**********************************
+ * FILE NAME: Transport.h
+ *
+ * DESCRIPTION: Transport interface implemented by the network backends
+ * 				(EmulNet: in-memory emulation, UdpNet: real UDP sockets,
+ * 				ShmNet: shared-memory rings between worker processes)
+ **********************************/
+
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include "stdincludes.h"
+#include "Member.h"
+#include "Trace.h"
+
+#define MSGCOUNT_LOG "msgcount.log"
+
+/**
+ * CLASS NAME: Transport
+ *
+ * DESCRIPTION: What MP1Node needs from the network.
+ * 				ENrecv hands every waiting message to enq, which copies the payload.
+ */
+class Transport {
+public:
+	virtual ~Transport() {}
+	virtual void *ENinit(Address *myaddr, short port) = 0;
+	virtual int ENsend(Address *myaddr, Address *toaddr, char *data, int size) = 0;
+	// Send the same message to count targets, returns how many were not dropped.
+	// Backends that can share one payload between the targets override this.
+	virtual int ENmulticast(Address *myaddr, Address *toaddrs, int count, char *data, int size) {
+		int sent = 0;
+		for ( int i = 0; i < count; i++ ) {
+			if ( ENsend(myaddr, &toaddrs[i], data, size) ) {
+				sent++;
+			}
+		}
+		return sent;
+	}
+	virtual int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue) = 0;
+	// Push out anything the backend batched during this tick
+	virtual void ENflush() {}
+	// Fault injection: nodes only reach nodes with the same partition label,
+	// a directed link can get its own loss probability (0 clears it). Ignored by default.
+	virtual void setPartition(int id, int label) {}
+	virtual void setLinkLoss(int src, int dst, double prob) {}
+	// Save or load the messages in flight and the backend's counters and RNGs,
+	// false if the backend's state lives outside this process and cannot be checkpointed
+	virtual bool checkpoint(Checkpoint &ck) {
+		return false;
+	}
+	// Record the send/receive decisions to trace or replay them from it, false if not supported
+	virtual bool setTrace(Trace *trace) {
+		return false;
+	}
+	virtual int ENcleanup() = 0;
+	virtual long long getSentBytes() = 0;
+	virtual long long getSentMessages() = 0;
+	int ENsend(Address *myaddr, Address *toaddr, string data) {
+		return ENsend(myaddr, toaddr, (char *)data.data(), (int)data.length());
+	}
+};
+
+#endif /* _TRANSPORT_H_ */
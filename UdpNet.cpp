@@ -0,0 +1,256 @@
+/**********************************
+ * FILE NAME: UdpNet.cpp
+ *
+ * DESCRIPTION: UDP transport backend definition
+ **********************************/
+
+#include "UdpNet.h"
+
+/**
+ * Constructor
+ */
+UdpNet::UdpNet(Params *p): par(p), nextid(1), lastPoll(-1), sent_bytes(0), sent_count(0), sendCalls(0), recvCalls(0), pollCalls(0),
+		packetsSent(0), packetsRecv(0), sendErrors(0) {
+	epfd = epoll_create1(0);
+	if ( epfd < 0 ) {
+		perror("epoll_create1");
+		exit(1);
+	}
+	unsigned int seed = par->SEED ? par->SEED : (unsigned int)time(NULL);
+	dropRng.seed(seed + 1 + par->LOCAL_NODE);
+	for ( int i = 0; i < UDP_BATCH; i++ ) {
+		riovs[i].iov_base = rbufs[i];
+		riovs[i].iov_len = UDP_MAX_DGRAM;
+		memset(&rmsgs[i], 0, sizeof(rmsgs[i]));
+		rmsgs[i].msg_hdr.msg_iov = &riovs[i];
+		rmsgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/**
+ * Destructor
+ */
+UdpNet::~UdpNet() {
+	for ( size_t i = 0; i < sockets.size(); i++ ) {
+		if ( sockets[i] ) {
+			close(sockets[i]->fd);
+			delete sockets[i];
+		}
+	}
+	close(epfd);
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Assign the next node id and, if the node runs in this process, bind its socket
+ */
+void *UdpNet::ENinit(Address *myaddr, short port) {
+	int id = nextid++;
+	*myaddr = Address(NodeId(id, 0));
+
+	if ( (int)sockets.size() <= id ) {
+		sockets.resize(id + 1, NULL);
+	}
+	if ( par->LOCAL_NODE && par->LOCAL_NODE != id ) {
+		return myaddr;
+	}
+
+	UdpSocket *s = new UdpSocket();
+	s->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+	if ( s->fd < 0 ) {
+		perror("socket");
+		exit(1);
+	}
+	int rcvbuf = UDP_RCVBUF;
+	setsockopt(s->fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(par->UDP_BASE_PORT + id);
+	if ( bind(s->fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ) {
+		perror("bind");
+		exit(1);
+	}
+
+	for ( int i = 0; i < UDP_BATCH; i++ ) {
+		s->iovs[i].iov_base = s->bufs[i];
+		s->msgs[i].msg_hdr.msg_iov = &s->iovs[i];
+		s->msgs[i].msg_hdr.msg_iovlen = 1;
+		s->msgs[i].msg_hdr.msg_name = &s->dests[i];
+		s->msgs[i].msg_hdr.msg_namelen = sizeof(s->dests[i]);
+	}
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.u32 = id;
+	epoll_ctl(epfd, EPOLL_CTL_ADD, s->fd, &ev);
+
+	sockets[id] = s;
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: socketOf
+ *
+ * DESCRIPTION: Socket of a local node, NULL if the node lives elsewhere
+ */
+UdpSocket *UdpNet::socketOf(Address *addr) {
+	int id = addr->getNodeId().getid();
+	if ( id <= 0 || id >= (int)sockets.size() ) {
+		return NULL;
+	}
+	return sockets[id];
+}
+
+/**
+ * FUNCTION NAME: ENsend
+ *
+ * DESCRIPTION: Queue a datagram on the sender's batch. The emulated drop rate still applies,
+ * 				so scenarios stay comparable with EmulNet.
+ *
+ * RETURNS:
+ * size
+ */
+int UdpNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
+	UdpSocket *s = socketOf(myaddr);
+	int sendmsg = uniform_int_distribution<int>(0, 99)(dropRng);
+
+	if ( s == NULL || size > UDP_MAX_DGRAM || size >= par->MAX_MSG_SIZE || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+		return 0;
+	}
+
+	int i = s->pending++;
+	NodeId to = toaddr->getNodeId();
+	memset(&s->dests[i], 0, sizeof(s->dests[i]));
+	s->dests[i].sin_family = AF_INET;
+	s->dests[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	s->dests[i].sin_port = htons(par->UDP_BASE_PORT + to.getid());
+	memcpy(s->bufs[i], data, size);
+	s->iovs[i].iov_len = size;
+
+	s->sent++;
+	sent_bytes += size;
+	sent_count++;
+
+	if ( s->pending == UDP_BATCH ) {
+		flushSocket(s);
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: flushSocket
+ *
+ * DESCRIPTION: Push the pending batch of one node with sendmmsg
+ */
+void UdpNet::flushSocket(UdpSocket *s) {
+	int done = 0;
+	while ( done < s->pending ) {
+		int n = sendmmsg(s->fd, &s->msgs[done], s->pending - done, 0);
+		sendCalls++;
+		if ( n <= 0 ) {
+			// socket buffer full or unreachable port: the rest of the batch is lost, like on a real network
+			sendErrors += s->pending - done;
+			break;
+		}
+		packetsSent += n;
+		done += n;
+	}
+	s->pending = 0;
+}
+
+/**
+ * FUNCTION NAME: ENflush
+ *
+ * DESCRIPTION: Push every pending batch. Called once per tick by the application layer.
+ */
+void UdpNet::ENflush() {
+	for ( size_t i = 0; i < sockets.size(); i++ ) {
+		if ( sockets[i] && sockets[i]->pending ) {
+			flushSocket(sockets[i]);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: poll
+ *
+ * DESCRIPTION: One epoll_wait per tick marks the sockets that have datagrams waiting. The sockets are
+ * 				level-triggered and only drained later by ENrecv, so the call has room for all of them:
+ * 				polling again for more would just report the same sockets.
+ */
+void UdpNet::poll() {
+	events.resize(max(sockets.size(), (size_t)1));
+	int n = epoll_wait(epfd, events.data(), events.size(), 0);
+	pollCalls++;
+	for ( int i = 0; i < n; i++ ) {
+		sockets[events[i].data.u32]->ready = true;
+	}
+	lastPoll = par->getcurrtime();
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Drain the node's socket with recvmmsg and hand every datagram to enq
+ *
+ * RETURN:
+ * 0
+ */
+int UdpNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue) {
+	UdpSocket *s = socketOf(myaddr);
+
+	if ( s == NULL ) {
+		return 0;
+	}
+	if ( lastPoll != par->getcurrtime() ) {
+		poll();
+	}
+	if ( !s->ready ) {
+		return 0;
+	}
+	s->ready = false;
+
+	int n;
+	do {
+		n = recvmmsg(s->fd, rmsgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+		recvCalls++;
+		for ( int i = 0; i < n; i++ ) {
+			(*enq)(queue, rbufs[i], rmsgs[i].msg_len);
+		}
+		if ( n > 0 ) {
+			packetsRecv += n;
+			s->recv += n;
+		}
+	} while ( n == UDP_BATCH );
+
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Flush, then write the per node counts and the syscall cost to msgcount.log
+ */
+int UdpNet::ENcleanup() {
+	ENflush();
+
+	FILE* file = fopen(par->logfile(MSGCOUNT_LOG).c_str(), "w+");
+	for ( size_t i = 1; i < sockets.size(); i++ ) {
+		if ( sockets[i] ) {
+			fprintf(file, "node %3zu sent_total %6ld  recv_total %6ld\n", i, sockets[i]->sent, sockets[i]->recv);
+		}
+	}
+	fprintf(file, "\nudp packets sent %ld recv %ld lost on send %ld\n", packetsSent, packetsRecv, sendErrors);
+	fprintf(file, "udp syscalls sendmmsg %ld recvmmsg %ld epoll_wait %ld\n", sendCalls, recvCalls, pollCalls);
+	if ( sendCalls ) {
+		fprintf(file, "udp packets per sendmmsg %.2f\n", (double)packetsSent / sendCalls);
+	}
+	fclose(file);
+
+	PROF_DUMP(par->logfile(PROFILE_LOG).c_str());
+	return 0;
+}
@@ -0,0 +1,100 @@
+/**********************************
+ * FILE NAME: UdpNet.h
+ *
+ * DESCRIPTION: UDP transport backend header file
+ **********************************/
+
+#ifndef _UDPNET_H_
+#define _UDPNET_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "Transport.h"
+#include "Profiler.h"
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <random>
+
+/*
+ * Macros
+ */
+// datagrams per sendmmsg/recvmmsg call
+#define UDP_BATCH 64
+// largest datagram we ever send (MAX_MSG_SIZE is smaller)
+#define UDP_MAX_DGRAM 4096
+#define UDP_RCVBUF (1 << 20)
+
+/**
+ * STRUCT NAME: UdpSocket
+ *
+ * DESCRIPTION: Socket and pending send batch of one local node
+ */
+typedef struct UdpSocket {
+	int fd;
+	// reported readable by the last epoll_wait
+	bool ready;
+	// datagrams queued for the next sendmmsg
+	int pending;
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovs[UDP_BATCH];
+	struct sockaddr_in dests[UDP_BATCH];
+	char bufs[UDP_BATCH][UDP_MAX_DGRAM];
+	long sent;
+	long recv;
+}UdpSocket;
+
+/**
+ * CLASS NAME: UdpNet
+ *
+ * DESCRIPTION: Nonblocking UDP backend. Node id N is bound to 127.0.0.1:UDP_BASE_PORT+N.
+ * 				Sends are batched per node and pushed with sendmmsg (when a batch fills up or on ENflush),
+ * 				readiness comes from one epoll_wait per tick and reads are drained with recvmmsg.
+ * 				The emulated drops are drawn from a generator seeded from SEED (and LOCAL_NODE).
+ * 				With LOCAL_NODE set only that node gets a socket, so N processes can share one host.
+ */
+class UdpNet : public Transport {
+private:
+	Params *par;
+	int epfd;
+	int nextid;
+	// indexed by node id, NULL for nodes living in another process
+	vector<UdpSocket *> sockets;
+	// tick of the last epoll_wait, and room for an event per socket
+	int lastPoll;
+	vector<struct epoll_event> events;
+	// draws of the emulated drop rate
+	mt19937 dropRng;
+	long long sent_bytes;
+	long long sent_count;
+	// syscall and packet accounting
+	long sendCalls, recvCalls, pollCalls;
+	long packetsSent, packetsRecv, sendErrors;
+	struct mmsghdr rmsgs[UDP_BATCH];
+	struct iovec riovs[UDP_BATCH];
+	char rbufs[UDP_BATCH][UDP_MAX_DGRAM];
+	void poll();
+	void flushSocket(UdpSocket *s);
+	UdpSocket *socketOf(Address *addr);
+public:
+	UdpNet(Params *p);
+	UdpNet(const UdpNet &anotherUdpNet) = delete;
+	UdpNet& operator = (const UdpNet &anotherUdpNet) = delete;
+	virtual ~UdpNet();
+	using Transport::ENsend;
+	void *ENinit(Address *myaddr, short port);
+	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
+	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	void ENflush();
+	int ENcleanup();
+	long long getSentBytes() {
+		return sent_bytes;
+	}
+	long long getSentMessages() {
+		return sent_count;
+	}
+};
+
+#endif /* _UDPNET_H_ */
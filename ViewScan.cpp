@@ -0,0 +1,61 @@
+/**********************************
+ * FILE NAME: ViewScan.cpp
+ *
+ * DESCRIPTION: Definition of the vectorized view scans. The kernel is picked when building:
+ * 				"make SIMD=avx2" or "make SIMD=sse4.2", plain C++ otherwise.
+ **********************************/
+
+#include "ViewScan.h"
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * FUNCTION NAME: scanBelow
+ *
+ * DESCRIPTION: Set bit k of mask when values[k] < limit, for k < n; the other bits of the
+ * 				last word are cleared. values must be readable up to n rounded up to SCAN_LANES.
+ */
+void scanBelow(const long *values, int n, long limit, uint64_t *mask) {
+	int k;
+
+	memset(mask, 0, MASK_WORDS(n) * sizeof(uint64_t));
+#if defined(__AVX2__)
+	__m256i lim = _mm256_set1_epi64x(limit);
+	for ( k = 0; k < n; k += 4 ) {
+		__m256i v = _mm256_loadu_si256((const __m256i *)(values + k));
+		uint64_t bits = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(lim, v)));
+		mask[k >> 6] |= bits << (k & 63);
+	}
+#elif defined(__SSE4_2__)
+	__m128i lim = _mm_set1_epi64x(limit);
+	for ( k = 0; k < n; k += 2 ) {
+		__m128i v = _mm_loadu_si128((const __m128i *)(values + k));
+		uint64_t bits = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(lim, v)));
+		mask[k >> 6] |= bits << (k & 63);
+	}
+#else
+	for ( k = 0; k < n; k++ ) {
+		mask[k >> 6] |= (uint64_t)(values[k] < limit) << (k & 63);
+	}
+#endif
+	// lanes past n
+	if ( n & 63 ) {
+		mask[n >> 6] &= (1ULL << (n & 63)) - 1;
+	}
+}
+
+/**
+ * FUNCTION NAME: scanKernel
+ *
+ * DESCRIPTION: Name of the kernel this build uses
+ */
+const char *scanKernel() {
+#if defined(__AVX2__)
+	return "avx2";
+#elif defined(__SSE4_2__)
+	return "sse4.2";
+#else
+	return "scalar";
+#endif
+}
@@ -0,0 +1,64 @@
+/**********************************
+ * FILE NAME: ViewScan.h
+ *
+ * DESCRIPTION: Vectorized scans over the columns of the membership tables
+ **********************************/
+
+#ifndef _VIEWSCAN_H_
+#define _VIEWSCAN_H_
+
+#include "stdincludes.h"
+#include <stdint.h>
+
+/*
+ * Macros
+ */
+// 64-bit lanes of the widest kernel (AVX2); view windows are padded to a multiple
+#define SCAN_LANES 4
+// alignment of the view columns
+#define SCAN_ALIGN 64
+// words of a bitmask over n entries
+#define MASK_WORDS(n) (((n) + 63) / 64)
+
+void scanBelow(const long *values, int n, long limit, uint64_t *mask);
+const char *scanKernel();
+
+/**
+ * FUNCTION NAME: maskTest
+ *
+ * DESCRIPTION: Is bit k of a bitmask set
+ */
+static inline bool maskTest(const uint64_t *mask, int k) {
+	return (mask[k >> 6] >> (k & 63)) & 1;
+}
+
+/**
+ * CLASS NAME: AlignedAllocator
+ *
+ * DESCRIPTION: vector allocator handing out SCAN_ALIGN aligned storage, so every padded
+ * 				view window starts on a vector boundary
+ */
+template<typename T> class AlignedAllocator {
+public:
+	typedef T value_type;
+	AlignedAllocator() {}
+	template<typename U> AlignedAllocator(const AlignedAllocator<U> &) {}
+	T *allocate(size_t n) {
+		void *mem = NULL;
+		if ( posix_memalign(&mem, SCAN_ALIGN, n * sizeof(T)) != 0 ) {
+			throw bad_alloc();
+		}
+		return (T *)mem;
+	}
+	void deallocate(T *p, size_t) {
+		free(p);
+	}
+	template<typename U> bool operator ==(const AlignedAllocator<U> &) const {
+		return true;
+	}
+	template<typename U> bool operator !=(const AlignedAllocator<U> &) const {
+		return false;
+	}
+};
+
+#endif /* _VIEWSCAN_H_ */